@@ -0,0 +1,73 @@
+// seat_min and seat_add with AVX2 against the scalar loops, on rows as long as real trains have
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "../src/system/seats.hpp"
+
+using namespace sjtu;
+
+constexpr static int ROWS = 4096; // a spread of rows, like the days of the trains a query touches
+constexpr static int ROUNDS = 200;
+
+volatile long sink;
+
+template<typename F>
+double time_per_call(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / ROWS / ROUNDS;
+}
+
+int main()
+{
+#ifdef SEATS_AVX2
+    if (!has_avx2())
+    {
+        printf("no avx2 on this cpu, seat_min and seat_add use the scalar loops\n");
+        return 0;
+    }
+    const int lengths[] = {8, 16, 32, 64, 99};
+    printf("%6s %12s %12s %12s %12s\n", "length", "min scalar", "min avx2", "add scalar", "add avx2");
+    for (int len: lengths)
+    {
+        int* data = new int[ROWS * len];
+        for (int i = 0; i < ROWS * len; i++)
+            data[i] = rand() % 100000;
+        long total = 0;
+        double min_scalar = time_per_call([&]
+        {
+            for (int k = 0; k < ROUNDS; k++)
+                for (int i = 0; i < ROWS; i++)
+                    total += seat_min_scalar(data + i * len, 0, len);
+        });
+        double min_avx2 = time_per_call([&]
+        {
+            for (int k = 0; k < ROUNDS; k++)
+                for (int i = 0; i < ROWS; i++)
+                    total -= seat_min_avx2(data + i * len, 0, len);
+        });
+        double add_scalar = time_per_call([&]
+        {
+            for (int k = 0; k < ROUNDS; k++)
+                for (int i = 0; i < ROWS; i++)
+                    seat_add_scalar(data + i * len, 0, len, k & 1 ? 1 : -1);
+        });
+        double add_avx2 = time_per_call([&]
+        {
+            for (int k = 0; k < ROUNDS; k++)
+                for (int i = 0; i < ROWS; i++)
+                    seat_add_avx2(data + i * len, 0, len, k & 1 ? 1 : -1);
+        });
+        // both minimums agree, so total is back to 0 unless one of them is wrong
+        if (total) printf("seat_min_avx2 disagrees with seat_min_scalar at length %d\n", len);
+        sink = total + data[0];
+        printf("%6d %10.2fns %10.2fns %10.2fns %10.2fns\n", len, min_scalar, min_avx2, add_scalar, add_avx2);
+        delete[] data;
+    }
+#else
+    printf("no avx2 build, seat_min and seat_add use the scalar loops\n");
+#endif
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "../file/Myfile.hpp"
 #include "../file/Datafile.hpp"
 #include "../STLite/algorithm.hpp"
+#include "Tree_Stats.hpp"
 
 namespace sjtu
 {
@@ -56,6 +57,7 @@ public:
             tmp.isleaf = true;
             tmp.size = 1;
             tmp.key[0] = key;
+            tmp.ptr[DEGREE] = 0;
             tmp.ptr[0] = data.new_space();
             data.write(tmp.ptr[0], value);
             file.write(head, tmp);
@@ -83,8 +85,26 @@ public:
         head = 0;
     }
 
+    // print layout statistics and check ordering, parent and sibling links
+    void stats(const std::string& name)
+    {
+        Tree_Stats res(DEGREE);
+        res.pages = file.pages();
+        res.free = file.free_pages();
+        res.data_pages = data.pages();
+        if (head)
+        {
+            long last_leaf = 0;
+            res.height = walk(head, 0, nullptr, nullptr, last_leaf, res);
+            if (file.readonly(last_leaf)->ptr[DEGREE])
+                res.fail("last leaf has a next pointer", last_leaf);
+        }
+        res.print(name, sizeof(K) + sizeof(long), sizeof(Node));
+    }
+
 private:
     constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(K));
+    constexpr static int PIN_LEVEL = 2; // the root and its children stay in the pinned tier
     struct Node
     {
         int size;
@@ -95,22 +115,59 @@ private:
     };
     long head = 0;
     Comp comp;
-    Myfile<Node, long> file;
+    Myfile<Node, long, DEGREE + 2> file; // room for the root and its most children
     Datafile<V> data;
 
     long find_Node(const K& key)
     {
         long res = head;
-        const Node* tmp = file.readonly(head);
-        while (!tmp->isleaf)
+        const Node* tmp = file.readpinned(head);
+        for (int level = 1; !tmp->isleaf; level++)
         {
             const K* found = upper_bound(tmp->key, tmp->key+tmp->size, key, comp);
             res = tmp->ptr[found - tmp->key];
-            tmp = file.readonly(res);
+            tmp = level < PIN_LEVEL ? file.readpinned(res) : file.readonly(res);
         }
         return res;
     }
 
+    // visit the subtree in key order, low <= keys < high; returns its height
+    int walk(long address, long parent, const K* low, const K* high, long& last_leaf, Tree_Stats& res)
+    {
+        Node node = *file.readonly(address); // copy: deeper visits may evict it
+        if (node.parent != parent) res.fail("wrong parent pointer", address);
+        for (int i = 1; i < node.size; i++)
+            if (!comp(node.key[i-1], node.key[i])) res.fail("keys out of order", address);
+        if (node.size && low && comp(node.key[0], *low)) res.fail("key below separator", address);
+        if (node.size && high && !comp(node.key[node.size-1], *high)) res.fail("key above separator", address);
+        if (node.isleaf)
+        {
+            res.add_leaf(node.size);
+            if (last_leaf && file.readonly(last_leaf)->ptr[DEGREE] != address)
+                res.fail("broken leaf chain", last_leaf);
+            last_leaf = address;
+            return 1;
+        }
+        res.add_internal();
+        int height = 0;
+        for (int i = 0; i <= node.size; i++)
+        {
+            int h = walk(node.ptr[i], address, i ? node.key+i-1 : low, i < node.size ? node.key+i : high, last_leaf, res);
+            if (height && h != height) res.fail("leaves at different depths", address);
+            height = h;
+        }
+        return height + 1;
+    }
+
+    // number of keys left in the old node when it splits:
+    // sequential inserts at either end keep the filled side nearly full
+    static int split_point(int locat, int last)
+    {
+        if (locat == last) return DEGREE - DEGREE / 10;
+        if (locat == 0) return DEGREE / 10;
+        return DEGREE / 2;
+    }
+
     void insert_leaf(long address, const K& key, const V& value)
     {
         Node& tmp = *file.readwrite(address);
@@ -128,7 +185,7 @@ private:
         tmp.size++;
         if (tmp.size < DEGREE)
             return;
-        int carry = DEGREE / 2;
+        int carry = split_point(locat, DEGREE - 1);
         long new_address = file.new_space();
         Node new_leaf;
         new_leaf.isleaf = true;
@@ -164,6 +221,7 @@ private:
             tmp->parent = new_head;
             head = new_head;
             file.write(new_head, new_node);
+            file.unpin_all(); // every pinned node moved one level down
             return;
         }
         Node& this_node = *file.readwrite(this_address);
@@ -182,7 +240,7 @@ private:
             return;
         }
         // split
-        int carry = DEGREE / 2;
+        int carry = split_point(locat, DEGREE);
         K tocarry = this_node.key[carry];
         long new_address = file.new_space();
         Node new_node;
@@ -357,6 +415,7 @@ private:
             son->parent = 0;
             head = this_node.ptr[0];
             file.delete_space(address);
+            file.unpin_all(); // every pinned node moved one level up
             return;
         }
         Node &parent_node = *file.readwrite(this_node.parent);
@@ -5,6 +5,7 @@
 #include "../file/Myfile.hpp"
 #include "../STLite/vector.hpp"
 #include "../STLite/algorithm.hpp"
+#include "Tree_Stats.hpp"
 
 namespace sjtu
 {
@@ -80,8 +81,25 @@ public:
         head = 0;
     }
 
+    // print layout statistics and check ordering, parent and sibling links
+    void stats(const std::string& name)
+    {
+        Tree_Stats res(DEGREE);
+        res.pages = file.pages();
+        res.free = file.free_pages();
+        if (head)
+        {
+            long last_leaf = 0;
+            res.height = walk(head, 0, nullptr, nullptr, last_leaf, res);
+            if (file.readonly(last_leaf)->ptr[1])
+                res.fail("last leaf has a next pointer", last_leaf);
+        }
+        res.print(name, sizeof(KVpair), sizeof(Node));
+    }
+
 private:
     constexpr static int DEGREE = 4000 / (sizeof(long) + sizeof(K) + sizeof(V));
+    constexpr static int PIN_LEVEL = 2; // the root and its children stay in the pinned tier
     struct KVpair
     {
         K key;
@@ -119,18 +137,18 @@ private:
         }
     } comp;
     long head = 0;
-    Myfile<Node, long> file;
+    Myfile<Node, long, DEGREE + 2> file; // room for the root and its most children
 
     long find_Node(const K& key, const V& value)
     {
         long res = head;
-        const Node* tmp = file.readonly(head);
+        const Node* tmp = file.readpinned(head);
         KVpair tofind(key, value);
-        while (tmp->ptr[0])
+        for (int level = 1; tmp->ptr[0]; level++)
         {
             const KVpair* found = upper_bound(tmp->data, tmp->data+tmp->size, tofind, comp);
             res = tmp->ptr[found - tmp->data];
-            tmp = file.readonly(res);
+            tmp = level < PIN_LEVEL ? file.readpinned(res) : file.readonly(res);
         }
         return res;
     }
@@ -138,16 +156,53 @@ private:
     long find_Node(const K& key)
     {
         long res = head;
-        const Node* tmp = file.readonly(head);
-        while (tmp->ptr[0])
+        const Node* tmp = file.readpinned(head);
+        for (int level = 1; tmp->ptr[0]; level++)
         {
             const KVpair* found = lower_bound(tmp->data, tmp->data+tmp->size, key, comp);
             res = tmp->ptr[found - tmp->data];
-            tmp = file.readonly(res);
+            tmp = level < PIN_LEVEL ? file.readpinned(res) : file.readonly(res);
         }
         return res;
     }
 
+    // visit the subtree in key order, low <= pairs < high; returns its height
+    int walk(long address, long parent, const KVpair* low, const KVpair* high, long& last_leaf, Tree_Stats& res)
+    {
+        Node node = *file.readonly(address); // copy: deeper visits may evict it
+        if (node.parent != parent) res.fail("wrong parent pointer", address);
+        for (int i = 1; i < node.size; i++)
+            if (!comp(node.data[i-1], node.data[i])) res.fail("keys out of order", address);
+        if (node.size && low && comp(node.data[0], *low)) res.fail("key below separator", address);
+        if (node.size && high && !comp(node.data[node.size-1], *high)) res.fail("key above separator", address);
+        if (!node.ptr[0])
+        {
+            res.add_leaf(node.size);
+            if (last_leaf && file.readonly(last_leaf)->ptr[1] != address)
+                res.fail("broken leaf chain", last_leaf);
+            last_leaf = address;
+            return 1;
+        }
+        res.add_internal();
+        int height = 0;
+        for (int i = 0; i <= node.size; i++)
+        {
+            int h = walk(node.ptr[i], address, i ? node.data+i-1 : low, i < node.size ? node.data+i : high, last_leaf, res);
+            if (height && h != height) res.fail("leaves at different depths", address);
+            height = h;
+        }
+        return height + 1;
+    }
+
+    // number of keys left in the old node when it splits:
+    // sequential inserts at either end keep the filled side nearly full
+    static int split_point(int locat, int last)
+    {
+        if (locat == last) return DEGREE - DEGREE / 10;
+        if (locat == 0) return DEGREE / 10;
+        return DEGREE / 2;
+    }
+
     void insert_leaf(long address, const K& key, const V& value)
     {
         Node& tmp = *file.readwrite(address);
@@ -161,7 +216,7 @@ private:
         tmp.size++;
         if (tmp.size < DEGREE)
             return;
-        int carry = DEGREE / 2;
+        int carry = split_point(locat, DEGREE - 1);
         long new_address = file.new_space();
         Node new_leaf;
         new_leaf.size = tmp.size - carry;
@@ -193,6 +248,7 @@ private:
             tmp->parent = new_head;
             head = new_head;
             file.write(new_head, new_node);
+            file.unpin_all(); // every pinned node moved one level down
             return;
         }
         Node& this_node = *file.readwrite(this_address);
@@ -211,7 +267,7 @@ private:
             return;
         }
         // split
-        int carry = DEGREE / 2;
+        int carry = split_point(locat, DEGREE);
         KVpair tocarry = this_node.data[carry];
         long new_address = file.new_space();
         Node new_node;
@@ -369,6 +425,7 @@ private:
             son->parent = 0;
             head = this_node.ptr[0];
             file.delete_space(address);
+            file.unpin_all(); // every pinned node moved one level up
             return;
         }
         Node &parent_node = *file.readwrite(this_node.parent);
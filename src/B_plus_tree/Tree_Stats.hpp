@@ -0,0 +1,72 @@
+// layout statistics and invariant checking for B+ trees
+#ifndef TREE_STATS_HPP
+#define TREE_STATS_HPP
+
+#include <iostream>
+#include <string>
+
+namespace sjtu
+{
+
+struct Tree_Stats
+{
+    int degree;
+    int height = 0;
+    long internal = 0;
+    long leaf = 0;
+    long entries = 0; // keys stored in leaves
+    long pages = 0; // index pages allocated, including free ones
+    long free = 0; // length of the free list
+    long data_pages = 0; // pages of the separate value file, if any
+    long histogram[10] = {}; // leaf fill factor in 10% buckets
+    const char* error = nullptr; // first broken invariant
+    long error_address = 0;
+
+    Tree_Stats(int d): degree(d) {}
+
+    void add_internal()
+    {
+        ++internal;
+    }
+
+    void add_leaf(int size)
+    {
+        ++leaf;
+        entries += size;
+        int bucket = size * 10 / degree;
+        ++histogram[bucket < 10 ? bucket : 9];
+    }
+
+    void fail(const char* what, long address)
+    {
+        if (error) return;
+        error = what;
+        error_address = address;
+    }
+
+    // entry_size: bytes a leaf spends per key, node_size: bytes per page
+    void print(const std::string& name, int entry_size, int node_size) const
+    {
+        std::cout << name << ": height " << height << ", internal " << internal << ", leaf " << leaf <<
+        ", pages " << pages << ", free " << free;
+        if (data_pages) std::cout << ", data pages " << data_pages;
+        std::cout << '\n';
+        long capacity = leaf * degree;
+        long used = capacity ? entries * 1000 / capacity : 0;
+        long wasted = (internal + leaf) * node_size - entries * entry_size + free * node_size;
+        std::cout << "  entries " << entries << ", leaf fill " << used / 10 << '.' << used % 10 << "%, wasted " <<
+        wasted / 1024 << " KB\n";
+        std::cout << "  leaf fill histogram:";
+        for (int i = 0; i < 10; i++)
+            std::cout << ' ' << i * 10 << "%:" << histogram[i];
+        std::cout << '\n';
+        if (error)
+            std::cout << "  error: " << error << " at " << error_address << '\n';
+        else
+            std::cout << "  ok\n";
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -3,6 +3,8 @@
 # define SJTU_ALLOCATOR_HPP
 
 #include <iostream>
+#include <cstdlib>
+#include <new>
 
 namespace sjtu
 {
@@ -13,7 +15,11 @@ class allocator
 public:
     allocator()
     {
-        space = (T*) malloc(size * sizeof(T));
+        // honour over-aligned element types such as cache-line aligned pages
+        void* p = nullptr;
+        if (posix_memalign(&p, alignof(T) > sizeof(void*) ? alignof(T) : sizeof(void*), size * sizeof(T)))
+            throw std::bad_alloc();
+        space = (T*) p;
     }
     ~allocator()
     {
@@ -11,26 +11,33 @@ template<typename V>
 class Datafile
 {
 public:
-    Datafile(const std::string& name): file(name, pos)
+    Datafile(const std::string& name): file(name, head)
     {
-        pos = file.head();
-        if (!pos)
+        head = file.head();
+        if (!head.pos)
         {
             Block tmp;
-            pos = file.new_space();
-            file.write(pos, tmp);
+            head.pos = file.new_space();
+            file.write(head.pos, tmp);
         }
     }
     ~Datafile()
     {
-        file.head() = pos;
+        file.head() = head;
     }
     
     long new_space()
     {
+        if (head.free)
+        {
+            long address = head.free;
+            head.free = *reinterpret_cast<const long*>(readonly(address));
+            return address;
+        }
+        long& pos = head.pos;
         Block* tmp = file.readwrite(pos);
         if (tmp->size < MAXSIZE)
-            return pos + (tmp->size++) * sizeof(V);
+            return pos + (tmp->size++) * SLOT;
         Block new_block;
         new_block.size++;
         pos = file.new_space();
@@ -38,52 +45,65 @@ public:
         return pos;
     }
 
+    // freed slots are chained through their first bytes and reused first
     void delete_space(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
-        long block_address = address - offset;
-        Block* block = file.readwrite(block_address);
-        if (--block->size) return;
-        if (block_address != pos)
-            file.delete_space(block_address);
+        *reinterpret_cast<long*>(readwrite(address)) = head.free;
+        head.free = address;
     }
 
     void write(long address, const V& value)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
+        long offset = (address - BASE) % sizeof(Block);
         Block* block = file.readwrite(address - offset);
-        block->data[offset / sizeof(V)] = value;
+        *reinterpret_cast<V*>(block->data + offset) = value;
     }
 
     const V* readonly(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
+        long offset = (address - BASE) % sizeof(Block);
         const Block* block = file.readonly(address - offset);
-        return (block->data + offset / sizeof(V));
+        return reinterpret_cast<const V*>(block->data + offset);
     }
 
     V* readwrite(long address)
     {
-        long offset = (address - 3 * sizeof(long)) % sizeof(Block);
+        long offset = (address - BASE) % sizeof(Block);
         Block* block = file.readwrite(address - offset);
-        return (block->data + offset / sizeof(V));
+        return reinterpret_cast<V*>(block->data + offset);
+    }
+
+    long pages() const
+    {
+        return file.pages();
     }
 
     void clean()
     {
         file.clean();
-        pos = 0;
+        Block tmp;
+        head.pos = file.new_space();
+        head.free = 0;
+        file.write(head.pos, tmp);
     }
 
 private:
-    constexpr static int MAXSIZE = std::max(4000/sizeof(V), 1UL);
+    // a slot is wide enough for the free list link even when V is not
+    constexpr static long SLOT = std::max(sizeof(V), sizeof(long));
+    constexpr static int MAXSIZE = std::max(4000/SLOT, 1L);
     struct Block
     {
-        V data[MAXSIZE];
-        int size = 0;
+        alignas(V) alignas(long) char data[MAXSIZE * SLOT];
+        int size = 0; // slots handed out so far
+    };
+    struct Header
+    {
+        long pos = 0; // block being filled
+        long free = 0; // first freed slot
     };
-    long pos = 0;
-    Myfile<Block, long> file;
+    constexpr static long BASE = Myfile<Block, Header>::BASE; // address of the first block
+    Header head;
+    Myfile<Block, Header> file;
 };
 
 }// namespace sjtu
@@ -0,0 +1,90 @@
+// a persistent dictionary interning strings as dense integer ids
+#ifndef DICTIONARY_HPP
+#define DICTIONARY_HPP
+
+#include "Myfile.hpp"
+#include "Mystring.hpp"
+#include "../B_plus_tree/BPT.hpp"
+
+namespace sjtu
+{
+
+template<int size>
+class Dictionary
+{
+public:
+    Dictionary(const std::string& name): index(name + "_dict"), file(name + "_names", count)
+    {
+        count = file.head();
+    }
+    ~Dictionary()
+    {
+        file.head() = count;
+    }
+
+    // id of s, or -1 if it was never interned
+    int find(const Mystring<size>& s)
+    {
+        auto found = index.readonly(s);
+        if (found == nullptr) return -1;
+        return *found;
+    }
+
+    int intern(const Mystring<size>& s)
+    {
+        auto found = index.readonly(s);
+        if (found != nullptr) return *found;
+        index.insert(s, count);
+        if (count % PER_BLOCK == 0)
+        {
+            Block tmp;
+            file.write(file.new_space(), tmp);
+        }
+        file.readwrite(block_address(count))->s[count % PER_BLOCK] = s;
+        return count++;
+    }
+
+    Mystring<size> name(int id)
+    {
+        return file.readonly(block_address(id))->s[id % PER_BLOCK];
+    }
+
+    int number() const
+    {
+        return count;
+    }
+
+    // layout of the index tree, named after the dictionary
+    void stats(const std::string& name)
+    {
+        index.stats(name + "_dict");
+        std::cout << name << "_names: pages " << file.pages() << '\n';
+    }
+
+    void clean()
+    {
+        index.clean();
+        file.clean();
+        count = 0;
+    }
+
+private:
+    constexpr static int PER_BLOCK = 4000 / sizeof(Mystring<size>);
+    struct Block
+    {
+        Mystring<size> s[PER_BLOCK];
+    };
+    int count = 0;
+    BPT<Mystring<size>, int> index;
+    Myfile<Block, int> file;
+
+    // blocks are allocated in id order and never freed
+    static long block_address(int id)
+    {
+        return Myfile<Block, int>::page(id / PER_BLOCK);
+    }
+};
+
+} // namespace sjtu
+
+#endif
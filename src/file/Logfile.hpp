@@ -0,0 +1,120 @@
+// a file of append-only lists, each kept in chunks of its own
+#ifndef LOGFILE_HPP
+#define LOGFILE_HPP
+
+#include <cstddef>
+#include "Myfile.hpp"
+#include "../STLite/vector.hpp"
+
+namespace sjtu
+{
+
+// a list is only reached through its List; a chunk holds records of one list, so reading
+// a list newest first takes one page per PER_CHUNK records
+template<typename V, int PER_CHUNK = 16>
+class Logfile
+{
+public:
+    struct List
+    {
+        long last = 0; // newest chunk, 0 while empty
+        int count = 0;
+    };
+
+    Logfile(const std::string& name): file(name, 0L) {}
+
+    // add value to list and return its address
+    long append(List& list, const V& value)
+    {
+        int at = list.count % PER_CHUNK;
+        if (!at)
+        {
+            Chunk tmp;
+            tmp.prev = list.last;
+            list.last = file.new_space();
+            file.write(list.last, tmp);
+        }
+        file.readwrite(list.last)->data[at] = value;
+        ++list.count;
+        ++file.head();
+        return address(list.last, at);
+    }
+
+    // address of the record n places before the newest, -1 past the oldest
+    long find(const List& list, int n)
+    {
+        if (n < 0 || n >= list.count) return -1;
+        long chunk = list.last;
+        int at = (list.count - 1) % PER_CHUNK - n;
+        while (at < 0)
+        {
+            chunk = file.readonly(chunk)->prev;
+            at += PER_CHUNK;
+        }
+        return address(chunk, at);
+    }
+
+    // every record of list, newest first
+    void read(const List& list, vector<V>& res)
+    {
+        res.reserve(list.count);
+        int at = (list.count - 1) % PER_CHUNK;
+        long chunk = list.last;
+        while (chunk)
+        {
+            const Chunk* c = file.readonly(chunk);
+            for (int i = at; i >= 0; i--)
+                res.push_back(c->data[i]);
+            chunk = c->prev;
+            at = PER_CHUNK - 1;
+        }
+    }
+
+    const V* readonly(long address)
+    {
+        long chunk = File::page_of(address);
+        return file.readonly(chunk)->data + (address - chunk - DATA) / sizeof(V);
+    }
+
+    V* readwrite(long address)
+    {
+        long chunk = File::page_of(address);
+        return file.readwrite(chunk)->data + (address - chunk - DATA) / sizeof(V);
+    }
+
+    // records appended to all lists since the last clean
+    long records()
+    {
+        return file.head();
+    }
+
+    long pages() const
+    {
+        return file.pages();
+    }
+
+    void clean()
+    {
+        file.clean();
+        file.head() = 0;
+    }
+
+private:
+    struct Chunk
+    {
+        long prev = 0; // older chunk of the same list
+        V data[PER_CHUNK];
+    };
+    typedef Myfile<Chunk, long> File;
+    constexpr static long DATA = offsetof(Chunk, data);
+    File file; // the header counts records
+
+    static long address(long chunk, int at)
+    {
+        return chunk + DATA + at * sizeof(V);
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,139 @@
+// a memory-mapped file that only grows, for data read far more often than written
+#ifndef MAPFILE_HPP
+#define MAPFILE_HPP
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sjtu
+{
+
+// the mapping covers the file and is remapped as the file grows, so a pointer into the file
+// is only good until the next append, extend or reserve; only the bytes below the file size may be touched
+class Mapfile
+{
+public:
+    constexpr static long GROW = 1L << 20;
+
+    Mapfile(const std::string& name): name(name + ".db")
+    {
+        fd = open(this->name.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd == -1) fail("open");
+        struct stat st;
+        if (fstat(fd, &st) == -1) fail("fstat");
+        size = st.st_size;
+        if (size < (long)sizeof(long)) reset();
+        else remap(size);
+    }
+    ~Mapfile()
+    {
+        if (base != nullptr) munmap(base, mapped);
+        close(fd);
+    }
+
+    // bytes in use, header included
+    long end() const
+    {
+        return *reinterpret_cast<const long*>(base);
+    }
+
+    // make [0, bytes) usable and zero what is new
+    void reserve(long bytes)
+    {
+        if (bytes <= size) return;
+        long grown = size * 2 > bytes ? size * 2 : bytes;
+        grown = (grown + GROW - 1) / GROW * GROW;
+        if (ftruncate(fd, grown) == -1) fail("ftruncate");
+        size = grown;
+        if (grown > mapped) remap(grown);
+    }
+
+    // grow the part in use to bytes, zeroed
+    void extend(long bytes)
+    {
+        if (bytes <= end()) return;
+        reserve(bytes);
+        *reinterpret_cast<long*>(base) = bytes;
+    }
+
+    // copy len bytes to the end, 8-byte aligned, and return their offset
+    long append(const char* data, int len)
+    {
+        long res = (end() + 7) / 8 * 8;
+        reserve(res + len);
+        memcpy(base + res, data, len);
+        *reinterpret_cast<long*>(base) = res + len;
+        return res;
+    }
+
+    char* at(long offset)
+    {
+        return base + offset;
+    }
+
+    const char* at(long offset) const
+    {
+        return base + offset;
+    }
+
+    void clean()
+    {
+        if (ftruncate(fd, 0) == -1) fail("ftruncate");
+        size = 0;
+        reset();
+    }
+
+private:
+    std::string name;
+    int fd;
+    long size; // of the file on disk
+    long mapped = 0; // bytes mapped at base, never less than size
+    char* base = nullptr;
+
+    void reset()
+    {
+        reserve(sizeof(long));
+        *reinterpret_cast<long*>(base) = sizeof(long);
+    }
+
+    // map the first bytes of the file, moving the mapping if it cannot grow in place
+    void remap(long bytes)
+    {
+        void* res;
+#ifdef MREMAP_MAYMOVE
+        if (base != nullptr)
+        {
+            res = mremap(base, mapped, bytes, MREMAP_MAYMOVE);
+            if (res == MAP_FAILED) fail("mremap");
+            base = static_cast<char*>(res);
+            mapped = bytes;
+            return;
+        }
+#else
+        // no mremap off Linux: map the file afresh
+        if (base != nullptr && munmap(base, mapped) == -1) fail("munmap");
+#endif
+        res = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (res == MAP_FAILED) fail("mmap");
+        base = static_cast<char*>(res);
+        mapped = bytes;
+    }
+
+    // the files are the database, so there is nothing sensible to go on with
+    [[noreturn]] void fail(const char* call) const
+    {
+        std::cerr << name << ": " << call << " failed: " << strerror(errno) << '\n';
+        exit(1);
+    }
+};
+
+} // namespace sjtu
+
+#endif
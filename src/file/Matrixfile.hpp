@@ -0,0 +1,99 @@
+// a file of int matrices addressed by row
+#ifndef MATRIXFILE_HPP
+#define MATRIXFILE_HPP
+
+#include "Myfile.hpp"
+
+namespace sjtu
+{
+
+// rows are padded to a power of two no smaller than a cache line and a matrix
+// starts on a row boundary, so every row is one aligned span inside a single page
+class Matrixfile
+{
+public:
+    constexpr static int PAGE_SIZE = 4096;
+    constexpr static int LINE = 64;
+
+    Matrixfile(const std::string& name): file(name, head)
+    {
+        head = file.head();
+    }
+    ~Matrixfile()
+    {
+        file.head() = head;
+    }
+
+    // bytes between two rows of a matrix with cols columns
+    static int stride(int cols)
+    {
+        int res = LINE;
+        while (res < cols * (int)sizeof(int)) res <<= 1;
+        return res;
+    }
+
+    // a rows x cols matrix with every cell set to value
+    long allocate(int rows, int cols, int value)
+    {
+        int step = stride(cols);
+        head.end = (head.end + step - 1) / step * step;
+        long res = BASE + head.end;
+        for (int r = 0; r < rows; r++)
+        {
+            if (head.end % PAGE_SIZE == 0)
+            {
+                Page tmp;
+                file.write(file.new_space(), tmp);
+            }
+            int* row = readwrite(res, cols, r);
+            for (int c = 0; c < cols; c++)
+                row[c] = value;
+            head.end += step;
+        }
+        return res;
+    }
+
+    const int* readonly(long matrix, int cols, int row)
+    {
+        long address = matrix + (long)row * stride(cols);
+        long page = File::page_of(address);
+        return file.readonly(page)->cell + (address - page) / sizeof(int);
+    }
+
+    int* readwrite(long matrix, int cols, int row)
+    {
+        long address = matrix + (long)row * stride(cols);
+        long page = File::page_of(address);
+        return file.readwrite(page)->cell + (address - page) / sizeof(int);
+    }
+
+    long pages() const
+    {
+        return file.pages();
+    }
+
+    void clean()
+    {
+        file.clean();
+        head.end = 0;
+    }
+
+private:
+    struct alignas(LINE) Page
+    {
+        int cell[PAGE_SIZE / sizeof(int)];
+    };
+    struct Header
+    {
+        long end = 0; // bytes handed out so far
+    };
+    typedef Myfile<Page, Header> File;
+    // pages are never freed, so bytes handed out map straight onto them
+    constexpr static long BASE = File::BASE;
+    Header head;
+    File file;
+};
+
+}// namespace sjtu
+
+#endif
@@ -1,4 +1,4 @@
-// a class for easy file I/O with LRU cache
+// a class for easy file I/O with LRU cache and a small pinned tier
 
 #ifndef MYFILE_HPP
 #define MYFILE_HPP
@@ -17,6 +17,8 @@ template<typename T, typename Header>
 class Basefile
 {
 public:
+    constexpr static long BASE = 2 * sizeof(long) + sizeof(Header); // address of the first page
+
     Basefile(const std::string& _name, const Header& _header)
     {
         name = _name;
@@ -93,9 +95,26 @@ public:
         return header;
     }
 
+    // number of pages ever allocated, including those on the free list
+    long pages() const
+    {
+        return (data_cursor - BASE) / sizeof(T);
+    }
+
+    long free_pages()
+    {
+        long res = 0;
+        for (long p = pool_cursor; p; ++res)
+        {
+            data.seekg(p);
+            data.read(reinterpret_cast <char *> (&p), sizeof(long));
+        }
+        return res;
+    }
+
     void clean()
     {
-        data_cursor = 2*sizeof(long) + sizeof(Header);
+        data_cursor = BASE;
         pool_cursor = 0;
         data.close();
         data.open(name+".db", std::ios::out);
@@ -105,27 +124,32 @@ public:
 
 private:
     std::fstream data;
-    long data_cursor = 2*sizeof(long) + sizeof(Header);
+    long data_cursor = BASE;
     long pool_cursor = 0;
     Header header;
     std::string name; 
 };
 
+// shared by lists of every capacity, so a node can tell which tier holds it
 template<typename T>
+struct Cache_Node
+{
+    Cache_Node* pre;
+    Cache_Node* next;
+    long address;
+    bool dirty;
+    bool pinned = false; // kept in the pinned tier, never evicted
+    T data;
+    Cache_Node(long a, const T& v, bool w, Cache_Node* p = nullptr, Cache_Node* n = nullptr):
+    address(a), data(v), dirty(w), pre(p), next(n) {}
+    Cache_Node() {}
+};
+
+template<typename T, int CAPACITY = MAX_CACHE>
 class Cache_List
 {
 public:
-    struct Cache_Node
-    {
-        Cache_Node* pre;
-        Cache_Node* next;
-        long address;
-        bool dirty;
-        T data;
-        Cache_Node(long a, const T& v, bool w, Cache_Node* p = nullptr, Cache_Node* n = nullptr):
-        address(a), data(v), dirty(w), pre(p), next(n) {}
-        Cache_Node() {}
-    };
+    typedef sjtu::Cache_Node<T> Cache_Node;
 
     Cache_List()
     {
@@ -144,6 +168,7 @@ public:
         tmp->address = address;
         tmp->data = data;
         tmp->dirty = write;
+        tmp->pinned = false;
         tmp->pre = head;
         tmp->next = head->next;
         head->next = tmp;
@@ -204,6 +229,7 @@ public:
     void clean()
     {
         memory.clean();
+        Size = 0;
         head = memory.new_space();
         end = memory.new_space();
         head->pre = end->next = nullptr;
@@ -215,9 +241,10 @@ private:
     int Size = 0;
     Cache_Node* head;
     Cache_Node* end;
-    allocator<Cache_Node, MAX_CACHE+5> memory;
+    allocator<Cache_Node, CAPACITY+5> memory;
 };
 
+template<int CAPACITY>
 class Hashmap
 {
 public:
@@ -280,13 +307,16 @@ private:
         Node(long k, long d): key(k), data(d), next(nullptr) {}
     };
     Node array[HASH_SIZE];
-    allocator<Node, MAX_CACHE+5> memory;
+    allocator<Node, CAPACITY+5> memory;
 };
 
-template<typename T, typename Header>
+// PINNED pages at most sit in the pinned tier, 0 for files that never pin
+template<typename T, typename Header, int PINNED = 0>
 class Myfile
 {
 public:
+    constexpr static long BASE = Basefile<T, Header>::BASE;
+
     Myfile(const std::string& name, const Header& _header): file(name, _header) {}
     ~Myfile()
     {
@@ -297,6 +327,7 @@ public:
                 file.write(tmp->address, tmp->data);
             tmp = tmp->next;
         }
+        unpin_all();
     }
 
     inline Header& head()
@@ -304,13 +335,35 @@ public:
         return file.head();
     }
 
+    // every page, freed or not, sits at BASE + k * sizeof(T) right after the file header
+    static long page(long k)
+    {
+        return BASE + k * sizeof(T);
+    }
+
+    // the page holding address
+    static long page_of(long address)
+    {
+        return address - (address - BASE) % sizeof(T);
+    }
+
+    long pages() const
+    {
+        return file.pages();
+    }
+
+    long free_pages()
+    {
+        return file.free_pages();
+    }
+
     const T* readonly(long address)
     {
         long found = node_map.find(address);
         if (found != -1)
         {
             auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
-            list.adjust_to_front(tmp);
+            if (!tmp->pinned) list.adjust_to_front(tmp);
             return &(tmp->data);
         }
         T value;
@@ -327,7 +380,7 @@ public:
         if (found != -1)
         {
             auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
-            list.adjust_to_front(tmp);
+            if (!tmp->pinned) list.adjust_to_front(tmp);
             tmp->dirty = true;
             return &(tmp->data);
         }
@@ -345,6 +398,49 @@ public:
         if (list.size() > MAX_CACHE) oversize();
     }
 
+    // like readonly, but moves the node into the pinned tier while there is room
+    const T* readpinned(long address)
+    {
+        long found = node_map.find(address);
+        typename Cache_List<T>::Cache_Node* ptr;
+        if (found != -1)
+        {
+            auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
+            if (tmp->pinned) return &(tmp->data);
+            if (pinned.size() >= PINNED)
+            {
+                list.adjust_to_front(tmp);
+                return &(tmp->data);
+            }
+            ptr = pinned.push_front(address, tmp->data, tmp->dirty);
+            list.erase(tmp);
+            node_map.erase(address);
+        }
+        else
+        {
+            if (pinned.size() >= PINNED) return readonly(address);
+            T value;
+            file.read(address, value);
+            ptr = pinned.push_front(address, value, false);
+        }
+        ptr->pinned = true;
+        node_map.insert(address, reinterpret_cast<long>(ptr));
+        return &(ptr->data);
+    }
+
+    // write back and release every pinned node, e.g. when the tree height changes
+    void unpin_all()
+    {
+        while (!pinned.empty())
+        {
+            auto tmp = pinned.back();
+            if (tmp->dirty)
+                file.write(tmp->address, tmp->data);
+            node_map.erase(tmp->address);
+            pinned.pop_back();
+        }
+    }
+
     long new_space()
     {
         return file.new_space();
@@ -357,7 +453,8 @@ public:
         if (found != -1)
         {
              auto tmp = reinterpret_cast<typename Cache_List<T>::Cache_Node*> (found);
-             list.erase(tmp);
+             if (tmp->pinned) pinned.erase(tmp);
+             else list.erase(tmp);
              node_map.erase(address);
         }
     }
@@ -366,13 +463,15 @@ public:
     {
         file.clean();
         list.clean();
+        pinned.clean();
         node_map.clean();
     }
 
 private:
     Basefile<T, Header> file;
     Cache_List<T> list;
-    Hashmap node_map;
+    Cache_List<T, PINNED> pinned;
+    Hashmap<MAX_CACHE+PINNED> node_map;
 
     void oversize()
     {
@@ -3,39 +3,49 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
 
 namespace sjtu
 {
 
+// zero-padded, so the whole array can be compared with one fixed-size memcmp
 template <int size>
 struct Mystring
 {
     char string[size];
+    unsigned char len;
     Mystring()
     {}
     Mystring(const std::string &s)
     {
-        strcpy(string, s.c_str());
+        assign(s.c_str(), s.size());
     }
     Mystring(const char *s)
     {
-        strcpy(string, s);
+        assign(s, strlen(s));
     }
-    void operator=(Mystring other)
+    void assign(const char *s, size_t n)
     {
-        strcpy(string, other.string);
+        memcpy(string, s, n);
+        memset(string + n, 0, size - n);
+        len = n;
     }
-    friend bool operator<(Mystring a, Mystring b)
+    friend bool operator<(const Mystring& a, const Mystring& b)
     {
-        return strcmp(a.string, b.string) < 0;
+        return memcmp(a.string, b.string, size) < 0;
     }
-    friend bool operator==(Mystring a, Mystring b)
+    friend bool operator==(const Mystring& a, const Mystring& b)
     {
-        return strcmp(a.string, b.string) == 0;
+        return a.len == b.len && memcmp(a.string, b.string, size) == 0;
     }
-    friend std::ostream& operator<<(std::ostream& out, Mystring s)
+    // three-way compare for composite keys
+    friend int compare(const Mystring& a, const Mystring& b)
     {
-        out << s.string;
+        return memcmp(a.string, b.string, size);
+    }
+    friend std::ostream& operator<<(std::ostream& out, const Mystring& s)
+    {
+        out.write(s.string, s.len);
         return out;
     }
 };
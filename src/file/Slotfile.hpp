@@ -0,0 +1,158 @@
+// a heap of variable-length records kept in slotted pages
+#ifndef SLOTFILE_HPP
+#define SLOTFILE_HPP
+
+#include <cstring>
+#include "Myfile.hpp"
+
+namespace sjtu
+{
+
+// a page holds a slot directory growing up from the front and record bytes
+// growing down from the back; an address is the page address plus the slot number
+class Slotfile
+{
+public:
+    constexpr static int PAGE_SIZE = 4096;
+
+    Slotfile(const std::string& name): file(name, head)
+    {
+        head = file.head();
+        if (!head.pos)
+        {
+            Page tmp;
+            head.pos = file.new_space();
+            file.write(head.pos, tmp);
+        }
+    }
+    ~Slotfile()
+    {
+        file.head() = head;
+    }
+
+    // largest record insert() accepts
+    constexpr static int capacity()
+    {
+        return PAGE_SIZE - HEADER - sizeof(Slot);
+    }
+
+    long insert(const char* record, int len)
+    {
+        short need = align(len);
+        Page* page = file.readwrite(head.pos);
+        int slot = page->free_slot();
+        if (page->room() < need + (slot == page->count ? (int)sizeof(Slot) : 0))
+        {
+            Page tmp;
+            head.pos = file.new_space();
+            file.write(head.pos, tmp);
+            page = file.readwrite(head.pos);
+            slot = 0;
+        }
+        if (slot == page->count) ++page->count;
+        page->end -= need;
+        page->slot(slot) = Slot{page->end, (short)len};
+        memcpy(page->bytes + page->end, record, len);
+        return head.pos + slot;
+    }
+
+    // the freed bytes are compacted away at once, so the page never fragments
+    void erase(long address)
+    {
+        int slot = slot_of(address);
+        long page_address = address - slot;
+        Page* page = file.readwrite(page_address);
+        Slot gone = page->slot(slot);
+        short len = align(gone.len);
+        memmove(page->bytes + page->end + len, page->bytes + page->end, gone.offset - page->end);
+        for (int i = 0; i < page->count; i++)
+            if (page->slot(i).len && page->slot(i).offset < gone.offset)
+                page->slot(i).offset += len;
+        page->end += len;
+        page->slot(slot).len = 0;
+        while (page->count && !page->slot(page->count-1).len)
+            --page->count;
+        if (!page->count && page_address != head.pos)
+            file.delete_space(page_address);
+    }
+
+    const char* readonly(long address)
+    {
+        int slot = slot_of(address);
+        const Page* page = file.readonly(address - slot);
+        return page->bytes + page->slot(slot).offset;
+    }
+
+    char* readwrite(long address)
+    {
+        int slot = slot_of(address);
+        Page* page = file.readwrite(address - slot);
+        return page->bytes + page->slot(slot).offset;
+    }
+
+    long pages() const
+    {
+        return file.pages();
+    }
+
+    void clean()
+    {
+        file.clean();
+        Page tmp;
+        head.pos = file.new_space();
+        file.write(head.pos, tmp);
+    }
+
+private:
+    struct Slot
+    {
+        short offset; // into the bytes of the page
+        short len; // 0 for a freed slot
+    };
+    constexpr static int HEADER = 2 * sizeof(short);
+    struct alignas(long) Page
+    {
+        short count = 0; // slots in the directory, freed ones included
+        short end = PAGE_SIZE - HEADER; // first byte of the record area in bytes
+        char bytes[PAGE_SIZE - HEADER];
+
+        Slot& slot(int i)
+        {
+            return reinterpret_cast<Slot*>(bytes)[i];
+        }
+        const Slot& slot(int i) const
+        {
+            return reinterpret_cast<const Slot*>(bytes)[i];
+        }
+        int room() const
+        {
+            return end - count * (int)sizeof(Slot);
+        }
+        int free_slot() const
+        {
+            for (int i = 0; i < count; i++)
+                if (!slot(i).len) return i;
+            return count;
+        }
+    };
+    struct Header
+    {
+        long pos = 0; // page being filled
+    };
+    constexpr static long BASE = Myfile<Page, Header>::BASE;
+    Header head;
+    Myfile<Page, Header> file;
+
+    static short align(int len)
+    {
+        return (len + 3) & ~3;
+    }
+    static int slot_of(long address)
+    {
+        return (address - BASE) % sizeof(Page);
+    }
+};
+
+}// namespace sjtu
+
+#endif
@@ -0,0 +1,337 @@
+// journeys with several transfers, found by scanning elementary connections in time order
+#ifndef CONNECTION_SCAN_HPP
+#define CONNECTION_SCAN_HPP
+
+#include "../STLite/algorithm.hpp"
+#include "../STLite/map.hpp"
+#include "../STLite/vector.hpp"
+#include "date.hpp"
+
+namespace sjtu
+{
+
+// one train running one segment on one day; times are minutes from 01-01 00:00
+struct Connection
+{
+    int dep;
+    int arr;
+    int trip; // the train on the day it leaves its first station, see Connection_Scan::trip
+    int train_no;
+    int price_f; // train price from its first station to from
+    int price_t; // and to to
+    short from;
+    short to;
+    Date start; // the day the train leaves its first station
+    char seg; // from is station seg of the train, to is seg+1
+};
+
+// a ride on one train of a journey
+struct Route_Leg
+{
+    int train_no;
+    Date start;
+    char f_id;
+    char t_id;
+    int dep;
+    int arr;
+    int cost;
+};
+
+// connections are compiled per day of departure and sorted the first time a search needs them;
+// a search keeps Pareto sets of (arrival, cost, transfers) per station and of (cost, transfers) per trip
+class Connection_Scan
+{
+public:
+    constexpr static int DAYS = 7; // a journey only uses connections leaving within this many days of its first
+    constexpr static long BUDGET = 64L << 20; // bytes of compiled connections kept before days outside a search window go
+
+    ~Connection_Scan()
+    {
+        clear();
+    }
+
+    // the connections leaving on day, nullptr until it is compiled
+    vector<Connection>* find_day(int day)
+    {
+        auto found = days.find(day);
+        if (found == days.end()) return nullptr;
+        return &found->second->connections;
+    }
+
+    vector<Connection>& new_day(int day)
+    {
+        Day* res = new Day;
+        days.insert(pair<const int, Day*>(day, res));
+        return res->connections;
+    }
+
+    // once the compiled days outgrow BUDGET, drop those outside [first, first+DAYS)
+    void evict(int first)
+    {
+        if (bytes <= BUDGET) return;
+        vector<int> stale;
+        for (auto it = days.begin(); it != days.end(); ++it)
+            if (it->first < first || it->first >= first + DAYS) stale.push_back(it->first);
+        for (size_t i = 0; i < stale.size(); i++)
+        {
+            auto found = days.find(stale[i]);
+            bytes -= found->second->connections.size() * sizeof(Connection);
+            delete found->second;
+            days.erase(found);
+        }
+    }
+
+    // every compiled day
+    void compiled(vector<int>& res)
+    {
+        for (auto it = days.begin(); it != days.end(); ++it)
+            res.push_back(it->first);
+    }
+
+    void add(int day, const Connection& c)
+    {
+        Day* found = days[day];
+        found->connections.push_back(c);
+        found->sorted = false;
+        bytes += sizeof(Connection);
+    }
+
+    // id of the first of the n daily trips of a train, handed out once per train
+    int trip(int train_no, int n)
+    {
+        while ((int)trip_base.size() <= train_no) trip_base.push_back(-1);
+        if (trip_base[train_no] == -1)
+        {
+            trip_base[train_no] = trips;
+            trips += n;
+        }
+        return trip_base[train_no];
+    }
+
+    // Pareto optimal journeys by (arrival, cost) from s, leaving on d, to t with at most max_transfers transfers,
+    // earliest first; stations bounds the station ids and days d to d+DAYS-1 must be compiled
+    void search(short s, short t, Date d, int max_transfers, int stations, vector<vector<Route_Leg>>& res)
+    {
+        ++stamp;
+        while ((int)bag_stamp.size() < stations)
+        {
+            bag_stamp.push_back(0);
+            bags.push_back(vector<int>());
+        }
+        while ((int)ride_stamp.size() < trips)
+        {
+            ride_stamp.push_back(0);
+            rides.push_back(vector<Ride>());
+        }
+        labels.clear();
+        target.clear();
+        // the origin may only board on d
+        Label origin;
+        origin.arr = d.n * 1440;
+        origin.cost = 0;
+        origin.transfers = -1;
+        origin.parent = -1;
+        labels.push_back(origin);
+        bag(s).push_back(0);
+        int last_board = (d.n + 1) * 1440;
+        for (int day = d.n; day < d.n + DAYS; day++)
+        {
+            vector<Connection>& conns = sorted_day(day);
+            for (size_t i = 0; i < conns.size(); i++)
+            {
+                const Connection& c = conns[i];
+                // board
+                if (bag_stamp[c.from] == stamp)
+                {
+                    vector<int>& at = bags[c.from];
+                    for (size_t j = 0; j < at.size(); j++)
+                    {
+                        const Label& l = labels[at[j]];
+                        if (l.arr > c.dep || l.transfers >= max_transfers) continue;
+                        if (l.parent == -1 && c.dep >= last_board) continue;
+                        Ride r;
+                        r.base = l.cost - c.price_f;
+                        r.transfers = l.transfers + 1;
+                        r.parent = at[j];
+                        r.f_id = c.seg;
+                        r.dep = c.dep;
+                        add_ride(c.trip, r);
+                    }
+                }
+                // alight
+                if (ride_stamp[c.trip] != stamp || c.to == s) continue;
+                vector<Ride>& on = rides[c.trip];
+                for (size_t j = 0; j < on.size(); j++)
+                {
+                    Label l;
+                    l.arr = c.arr;
+                    l.cost = on[j].base + c.price_t;
+                    l.transfers = on[j].transfers;
+                    l.parent = on[j].parent;
+                    l.leg.train_no = c.train_no;
+                    l.leg.start = c.start;
+                    l.leg.f_id = on[j].f_id;
+                    l.leg.t_id = c.seg + 1;
+                    l.leg.dep = on[j].dep;
+                    l.leg.arr = c.arr;
+                    l.leg.cost = c.price_t - labels[l.parent].cost + on[j].base;
+                    if (reached(l)) continue;
+                    if (c.to == t) add_target(l);
+                    else add_label(c.to, l);
+                }
+            }
+        }
+        // unwind each journey, the target set is already earliest first
+        for (size_t i = 0; i < target.size(); i++)
+        {
+            vector<Route_Leg> journey;
+            for (int x = target[i]; labels[x].parent != -1; x = labels[x].parent)
+                journey.push_back(labels[x].leg);
+            vector<Route_Leg> forward;
+            for (int j = journey.size() - 1; j >= 0; j--)
+                forward.push_back(journey[j]);
+            res.push_back(forward);
+        }
+    }
+
+    void clear()
+    {
+        for (auto it = days.begin(); it != days.end(); ++it)
+            delete it->second;
+        days.clear();
+        bytes = 0;
+        trip_base.clear();
+        trips = 0;
+        rides.clear();
+        ride_stamp.clear();
+    }
+
+private:
+    struct Day
+    {
+        vector<Connection> connections;
+        bool sorted = false;
+    };
+    struct Label
+    {
+        int arr;
+        int cost;
+        int transfers;
+        int parent; // label the last train was boarded from, -1 for the origin
+        Route_Leg leg;
+    };
+    // a way of being on a trip
+    struct Ride
+    {
+        int base; // cost so far minus the train price up to the boarding station
+        int transfers;
+        int parent;
+        char f_id;
+        int dep;
+    };
+    map<int, Day*> days;
+    long bytes = 0; // taken by the connections of every compiled day
+    vector<int> trip_base; // by train_no
+    int trips = 0;
+    // search state, valid where the stamp matches
+    long stamp = 0;
+    vector<Label> labels;
+    vector<vector<int>> bags; // Pareto labels by station
+    vector<long> bag_stamp;
+    vector<vector<Ride>> rides; // Pareto rides by trip
+    vector<long> ride_stamp;
+    vector<int> target; // Pareto labels at t by (arrival, cost), earliest first
+
+    vector<Connection>& sorted_day(int day)
+    {
+        Day* found = days[day];
+        if (!found->sorted && found->connections.size() > 1)
+            sort(&found->connections[0], &found->connections[0] + found->connections.size(),
+            [](const Connection& a, const Connection& b)
+            {
+                return a.dep < b.dep;
+            });
+        found->sorted = true;
+        return found->connections;
+    }
+
+    vector<int>& bag(short station)
+    {
+        if (bag_stamp[station] != stamp)
+        {
+            bag_stamp[station] = stamp;
+            bags[station].clear();
+        }
+        return bags[station];
+    }
+
+    void add_ride(int trip, const Ride& r)
+    {
+        if (ride_stamp[trip] != stamp)
+        {
+            ride_stamp[trip] = stamp;
+            rides[trip].clear();
+        }
+        vector<Ride>& on = rides[trip];
+        for (size_t i = 0; i < on.size(); i++)
+            if (on[i].base <= r.base && on[i].transfers <= r.transfers) return;
+        int n = 0;
+        for (size_t i = 0; i < on.size(); i++)
+            if (!(r.base <= on[i].base && r.transfers <= on[i].transfers)) on[n++] = on[i];
+        while ((int)on.size() > n) on.pop_back();
+        on.push_back(r);
+    }
+
+    void add_label(short station, const Label& l)
+    {
+        vector<int>& at = bag(station);
+        for (size_t i = 0; i < at.size(); i++)
+        {
+            const Label& o = labels[at[i]];
+            if (o.arr <= l.arr && o.cost <= l.cost && o.transfers <= l.transfers) return;
+        }
+        int n = 0;
+        for (size_t i = 0; i < at.size(); i++)
+        {
+            const Label& o = labels[at[i]];
+            if (!(l.arr <= o.arr && l.cost <= o.cost && l.transfers <= o.transfers)) at[n++] = at[i];
+        }
+        while ((int)at.size() > n) at.pop_back();
+        at.push_back(labels.size());
+        labels.push_back(l);
+    }
+
+    // whether a journey already found is no later and no dearer than anything l leads to
+    bool reached(const Label& l)
+    {
+        for (size_t i = 0; i < target.size(); i++)
+        {
+            const Label& o = labels[target[i]];
+            if (o.arr <= l.arr && o.cost <= l.cost) return true;
+        }
+        return false;
+    }
+
+    // l is not dominated; connections come in order of departure, not arrival, so keep target sorted
+    void add_target(const Label& l)
+    {
+        int n = 0;
+        for (size_t i = 0; i < target.size(); i++)
+        {
+            const Label& o = labels[target[i]];
+            if (!(l.arr <= o.arr && l.cost <= o.cost)) target[n++] = target[i];
+        }
+        while ((int)target.size() > n) target.pop_back();
+        int pos = 0;
+        while (pos < (int)target.size() && labels[target[pos]].arr <= l.arr) ++pos;
+        target.push_back(0);
+        for (int i = target.size() - 1; i > pos; i--)
+            target[i] = target[i-1];
+        target[pos] = labels.size();
+        labels.push_back(l);
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -8,117 +8,98 @@
 namespace sjtu
 {
 
+// first day of each month in a non-leap year, counted from 01-01
+constexpr short month_start[13] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365};
+
+// "mm-dd" of every day of the year, so printing a Date is a table lookup
+struct Date_Names
+{
+    char s[365][5];
+    constexpr Date_Names(): s()
+    {
+        for (int m = 0; m < 12; m++)
+            for (int d = month_start[m]; d < month_start[m+1]; d++)
+            {
+                int day = d - month_start[m] + 1;
+                s[d][0] = '0' + (m + 1) / 10;
+                s[d][1] = '0' + (m + 1) % 10;
+                s[d][2] = '-';
+                s[d][3] = '0' + day / 10;
+                s[d][4] = '0' + day % 10;
+            }
+    }
+};
+constexpr Date_Names date_names;
+
+// a day counted from 01-01; days past 12-31 roll into the next year
 struct Date
 {
-    char m;
-    char d;
+    short n;
 
     Date() {}
     Date(const std::string& s)
     {
-        m = 10 * (s[0] - '0') + s[1] - '0';
-        d = 10 * (s[3] - '0') + s[4] - '0';
+        int m = 10 * (s[0] - '0') + s[1] - '0';
+        int d = 10 * (s[3] - '0') + s[4] - '0';
+        n = month_start[m-1] + d - 1;
     }
 
     inline void operator++()
     {
-        if (++d < 31) return;
-        if (d == 31)
-        {
-            if (m == 6)
-            {
-                ++m;
-                d = 1;
-                return;
-            }
-            return;
-        } 
-        ++m;
-        d = 1;
+        ++n;
     }
 
     inline void operator+=(int x)
     {
-        d += x;
-        if (d < 31) return;
-        if (d == 31)
-        {
-            if (m == 6)
-            {
-                ++m;
-                d -= 30;
-            }
-            return;
-        }
-        d -= m == 6 ? 30 : 31;
-        ++m;
+        n += x;
     }
 
     inline Date operator+(int x) const
     {
         Date res = *this;
-        res += x;
+        res.n += x;
         return res;
     }
 
     inline void operator--()
     {
-        if (--d > 0) return;
-        --m;
-        if (m == 6)
-        {
-            d = 30;
-            return;
-        }
-        d = 31;
+        --n;
     }
 
     inline void operator-=(int x)
     {
-        if (d > x)
-        {
-            d -= x;
-            return;
-        }
-        --m;
-        d += m == 6 ? 30 : 31;
-        d -= x;
+        n -= x;
     }
 
     inline Date operator-(int x) const
     {
         Date res = *this;
-        res -= x;
+        res.n -= x;
         return res;
     }
 
     inline friend bool operator<(Date a, Date b)
     {
-        if (a.m != b.m) return a.m < b.m;
-        return a.d < b.d;
+        return a.n < b.n;
     }
 
     inline friend bool operator==(Date a, Date b)
     {
-        return a.m == b.m && a.d == b.d;
+        return a.n == b.n;
     }
 
     friend std::ostream& operator<<(std::ostream& out, Date x)
     {
-        out << x.m / 10 << x.m % 10 << '-' << x.d / 10 << x.d % 10;
+        // days before 01-01 wrap into the previous year
+        int day = x.n % 365;
+        if (day < 0) day += 365;
+        out.write(date_names.s[day], 5);
         return out;
     }
 
     friend int operator-(Date a, Date b)
     {
-        int res = 0;
-        while (a.m > b.m)
-        {
-            res += a.d;
-            a.d = 1;
-            --a;
-        }
-        return res + a.d - b.d;
+        return a.n - b.n;
     }
 };
 
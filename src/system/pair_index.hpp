@@ -0,0 +1,118 @@
+// an optional materialized index from ordered station pairs to the trains running between them
+#ifndef PAIR_INDEX_HPP
+#define PAIR_INDEX_HPP
+
+#include <cstdlib>
+#include <iostream>
+#include "../file/Myfile.hpp"
+#include "../B_plus_tree/Multi_BPT.hpp"
+#include "../STLite/vector.hpp"
+
+namespace sjtu
+{
+
+struct Pair_Info
+{
+    int train_no;
+    char f; // index of the first station on the train
+    char t; // index of the second station on the train
+    friend bool operator<(const Pair_Info& a, const Pair_Info& b)
+    {
+        return a.train_no < b.train_no;
+    }
+    friend bool operator==(const Pair_Info& a, const Pair_Info& b)
+    {
+        return a.train_no == b.train_no;
+    }
+};
+
+// only pairs of stations served by at least degree trains are indexed, 0 leaves the index off;
+// an index keeps the degree it was built with until it is cleaned
+class Pair_Index
+{
+public:
+    constexpr static int DEFAULT_DEGREE = 64;
+    constexpr static long DEFAULT_BUDGET = 4000000;
+
+    Pair_Index(const std::string& name, int degree = configured_degree(), long budget = DEFAULT_BUDGET):
+    tree(name), meta(name + "_meta", Meta(degree)), fresh_degree(degree), budget(budget) {}
+
+    // PAIR_DEGREE from the environment, DEFAULT_DEGREE if it is unset
+    static int configured_degree()
+    {
+        const char* env = getenv("PAIR_DEGREE");
+        return env == nullptr ? DEFAULT_DEGREE : atoi(env);
+    }
+
+    int degree()
+    {
+        return meta.head().degree;
+    }
+
+    bool enabled()
+    {
+        return degree() > 0;
+    }
+
+    // whether the entries for hot stations are complete
+    bool usable()
+    {
+        return enabled() && !meta.head().full;
+    }
+
+    // false once budget entries are stored; the index is then given up for good
+    bool insert(short a, short b, const Pair_Info& info)
+    {
+        Meta& m = meta.head();
+        if (m.full) return false;
+        if (m.count >= budget)
+        {
+            m.full = true;
+            return false;
+        }
+        tree.insert(key(a, b), info);
+        ++m.count;
+        return true;
+    }
+
+    // trains from a to b, sorted by train_no
+    void find(short a, short b, vector<Pair_Info>& res)
+    {
+        tree.find(key(a, b), res);
+    }
+
+    void stats()
+    {
+        tree.stats("station_pair");
+        std::cout << "  pair entries " << meta.head().count << (meta.head().full ? ", over budget\n" : "\n");
+    }
+
+    void clean()
+    {
+        tree.clean();
+        meta.clean();
+        meta.head() = Meta(fresh_degree);
+    }
+
+private:
+    struct Meta
+    {
+        long count = 0;
+        int degree;
+        bool full = false;
+        Meta(int degree = 0): degree(degree) {}
+    };
+    Multi_BPT<int, Pair_Info> tree;
+    Basefile<long, Meta> meta; // only its header is used
+    int fresh_degree; // for an index built from scratch
+    long budget; // most entries ever stored; past it the index gives up and queries stop using it
+
+    static int key(short a, short b)
+    {
+        return (int)a << 16 | (unsigned short)b;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -241,18 +241,18 @@ public:
             data.start_date = d[0];
             data.end_date = d[1];
             data.type = y;
-            strcpy(data.stations[0], s[0].c_str());
+            data.stations[0] = train_system.station_id(s[0]);
             data.seat = m;
             data.leave_time[0] = x;
             data.price[0] = 0;
             for (char i = 1; i < n-1; i++)
             {
-                strcpy(data.stations[i], s[i].c_str());
+                data.stations[i] = train_system.station_id(s[i]);
                 data.arrive_time[i-1] = data.leave_time[i-1] + std::stoi(t[i-1]);
                 data.leave_time[i] = data.arrive_time[i-1] + std::stoi(o[i-1]);
                 data.price[i] = data.price[i-1] + std::stoi(p[i-1]);
             }
-            strcpy(data.stations[n-1], s[n-1].c_str());
+            data.stations[n-1] = train_system.station_id(s[n-1]);
             data.arrive_time[n-2] = data.leave_time[n-2] + std::stoi(t[n-2]);
             data.price[n-1] = data.price[n-2] + std::stoi(p[n-2]);
             train_system.add_train(id, data);
@@ -283,6 +283,7 @@ public:
             Mystring<31> s, t;
             Date d;
             bool p = 0;
+            int k = 0;
             for (int i = 2; i < tokens.size(); i += 2)
             {
                 if (tokens[i] == "-s")
@@ -291,10 +292,30 @@ public:
                     t = tokens[i+1];
                 else if (tokens[i] == "-d")
                     d = tokens[i+1];
+                else if (tokens[i] == "-k")
+                    k = std::stoi(tokens[i+1]);
                 else if (tokens[i+1] == "cost")
                     p = 1;
             }
-            train_system.query_transfer(s, t, d, p);
+            train_system.query_transfer(s, t, d, p, k);
+        }
+        else if (tokens[1] == "query_route")
+        {
+            Mystring<31> s, t;
+            Date d;
+            int n = 2;
+            for (int i = 2; i < tokens.size(); i += 2)
+            {
+                if (tokens[i] == "-s")
+                    s = tokens[i+1];
+                else if (tokens[i] == "-t")
+                    t = tokens[i+1];
+                else if (tokens[i] == "-d")
+                    d = tokens[i+1];
+                else if (tokens[i] == "-n")
+                    n = std::stoi(tokens[i+1]);
+            }
+            train_system.query_route(s, t, d, n);
         }
         else if (tokens[1] == "refund_ticket")
         {
@@ -312,6 +333,11 @@ public:
             else
                 std::cout << "-1\n";
         }
+        else if (tokens[1] == "tree_stats")
+        {
+            user_system.tree_stats();
+            train_system.tree_stats();
+        }
         else if (tokens[1] == "clean")
         {
             train_system.clean();
@@ -0,0 +1,134 @@
+// a bounded cache of query results keyed by (from, to, date, order)
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include "../STLite/vector.hpp"
+#include "date.hpp"
+
+namespace sjtu
+{
+
+// entries sit in a hash table for lookup and in a list from most to least recently used,
+// the same layout as Myfile's page cache
+template<typename T, int CAPACITY>
+class Result_Cache
+{
+public:
+    struct Key
+    {
+        short from;
+        short to;
+        Date d;
+        bool p;
+        friend bool operator==(const Key& a, const Key& b)
+        {
+            return a.from == b.from && a.to == b.to && a.d.n == b.d.n && a.p == b.p;
+        }
+    };
+
+    Result_Cache()
+    {
+        head.pre = end.next = nullptr;
+        head.next = &end;
+        end.pre = &head;
+        for (int i = 0; i < BUCKETS; i++)
+            bucket[i] = nullptr;
+    }
+    ~Result_Cache()
+    {
+        clear();
+    }
+
+    // nullptr on a miss
+    const vector<T>* find(const Key& key)
+    {
+        Entry* found = bucket[hash(key)];
+        while (found != nullptr && !(found->key == key)) found = found->chain;
+        if (found == nullptr) return nullptr;
+        unlink(found);
+        push_front(found);
+        return &found->value;
+    }
+
+    // the least recently used entry makes room once the cache is full
+    void insert(const Key& key, const vector<T>& value)
+    {
+        if (size >= CAPACITY) erase(end.pre);
+        Entry* entry = new Entry;
+        entry->key = key;
+        entry->value = value;
+        Entry*& first = bucket[hash(key)];
+        entry->chain = first;
+        first = entry;
+        push_front(entry);
+        ++size;
+    }
+
+    // drop every entry whose key stale(key) holds for
+    template<typename Pred>
+    void erase_if(Pred stale)
+    {
+        Entry* p = head.next;
+        while (p != &end)
+        {
+            Entry* next = p->next;
+            if (stale(p->key)) erase(p);
+            p = next;
+        }
+    }
+
+    void clear()
+    {
+        while (size) erase(end.pre);
+    }
+
+private:
+    constexpr static int BUCKETS = 2 * CAPACITY + 1;
+    struct Entry
+    {
+        Entry* pre;
+        Entry* next;
+        Entry* chain; // next in the same bucket
+        Key key;
+        vector<T> value;
+    };
+    Entry head; // sentinels of the recency list
+    Entry end;
+    Entry* bucket[BUCKETS];
+    int size = 0;
+
+    static int hash(const Key& key)
+    {
+        unsigned long packed = (unsigned long)(unsigned short)key.from << 33 | (unsigned long)(unsigned short)key.to << 17 |
+            (unsigned long)(unsigned short)key.d.n << 1 | key.p;
+        return packed % BUCKETS;
+    }
+
+    void unlink(Entry* p)
+    {
+        p->pre->next = p->next;
+        p->next->pre = p->pre;
+    }
+
+    void push_front(Entry* p)
+    {
+        p->pre = &head;
+        p->next = head.next;
+        head.next->pre = p;
+        head.next = p;
+    }
+
+    void erase(Entry* p)
+    {
+        unlink(p);
+        Entry** link = &bucket[hash(p->key)];
+        while (*link != p) link = &(*link)->chain;
+        *link = p->chain;
+        delete p;
+        --size;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,99 @@
+// range min and range add over a row of seat counts, the inner loops of every ticket operation
+#ifndef SEATS_HPP
+#define SEATS_HPP
+
+#include <climits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SEATS_AVX2
+#endif
+
+namespace sjtu
+{
+
+#ifdef SEATS_AVX2
+// compiled for AVX2 regardless of the build flags, and only called when the cpu has it
+__attribute__((target("avx2"))) inline int seat_min_avx2(const int* row, int l, int r)
+{
+    __m256i m = _mm256_set1_epi32(INT_MAX);
+    int i = l;
+    for (; i + 8 <= r; i += 8)
+        m = _mm256_min_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+    __m128i h = _mm_min_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, 0x4e));
+    h = _mm_min_epi32(h, _mm_shuffle_epi32(h, 0xb1));
+    int res = _mm_cvtsi128_si32(h);
+    for (; i < r; i++)
+        if (row[i] < res) res = row[i];
+    return res;
+}
+
+__attribute__((target("avx2"))) inline void seat_add_avx2(int* row, int l, int r, int x)
+{
+    __m256i v = _mm256_set1_epi32(x);
+    int i = l;
+    for (; i + 8 <= r; i += 8)
+    {
+        __m256i* p = reinterpret_cast<__m256i*>(row + i);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), v));
+    }
+    for (; i < r; i++)
+        row[i] += x;
+}
+
+inline bool has_avx2()
+{
+    static const bool res = __builtin_cpu_supports("avx2");
+    return res;
+}
+#endif
+
+inline int seat_min_scalar(const int* row, int l, int r)
+{
+    int res = INT_MAX;
+    for (int i = l; i < r; i++)
+        if (row[i] < res) res = row[i];
+    return res;
+}
+
+inline void seat_add_scalar(int* row, int l, int r, int x)
+{
+    for (int i = l; i < r; i++)
+        row[i] += x;
+}
+
+// fewest seats left on segments [l, r)
+inline int seat_min(const int* row, int l, int r)
+{
+#ifdef SEATS_AVX2
+    if (r - l >= 8 && has_avx2()) return seat_min_avx2(row, l, r);
+#endif
+    return seat_min_scalar(row, l, r);
+}
+
+// most seats left on any segment in [l, r)
+inline int seat_max(const int* row, int l, int r)
+{
+    int res = 0;
+    for (int i = l; i < r; i++)
+        if (row[i] > res) res = row[i];
+    return res;
+}
+
+// add x seats to every segment in [l, r)
+inline void seat_add(int* row, int l, int r, int x)
+{
+#ifdef SEATS_AVX2
+    if (r - l >= 8 && has_avx2())
+    {
+        seat_add_avx2(row, l, r, x);
+        return;
+    }
+#endif
+    seat_add_scalar(row, l, r, x);
+}
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,153 @@
+// a work-stealing thread pool for splitting loops across cores
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "../STLite/vector.hpp"
+
+namespace sjtu
+{
+
+// every worker owns a queue of chunks, takes from its front and steals from the back of
+// the others; threads are only started by the first parallel_for
+class Thread_Pool
+{
+public:
+    // workers < 0 for one per core besides the caller
+    Thread_Pool(int workers = -1): workers(workers) {}
+    ~Thread_Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (int i = 0; i < threads.size(); i++)
+        {
+            threads[i]->join();
+            delete threads[i];
+        }
+        for (int i = 0; i < queues.size(); i++)
+            delete queues[i];
+    }
+
+    // body(begin, end) over [0, n) in chunks of grain; the caller works too and returns when all are done
+    template<typename F>
+    void parallel_for(int n, int grain, const F& body)
+    {
+        start();
+        std::function<void(int)> run = [&](int chunk)
+        {
+            int begin = chunk * grain;
+            body(begin, begin + grain < n ? begin + grain : n);
+        };
+        int chunks = (n + grain - 1) / grain;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &run;
+            left = chunks;
+            for (int c = 0; c < chunks; c++)
+            {
+                Queue* q = queues[c % queues.size()];
+                std::lock_guard<std::mutex> queue_lock(q->mutex);
+                q->chunks.push_back(c);
+            }
+            ++generation;
+        }
+        wake.notify_all();
+        drain(queues.size() - 1);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return left == 0; });
+        job = nullptr;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<int> chunks;
+    };
+    vector<std::thread*> threads;
+    vector<Queue*> queues; // one per worker, the last for the calling thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(int)>* job = nullptr;
+    std::atomic<int> left{0};
+    long generation = 0;
+    bool stop = false;
+    int workers;
+
+    void start()
+    {
+        if (!queues.empty()) return;
+        if (workers < 0) workers = (int)std::thread::hardware_concurrency() - 1;
+        if (workers < 0) workers = 0;
+        for (int i = 0; i <= workers; i++)
+            queues.push_back(new Queue);
+        for (int i = 0; i < workers; i++)
+            threads.push_back(new std::thread([this, i] { loop(i); }));
+    }
+
+    void loop(int self)
+    {
+        long seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            drain(self);
+        }
+    }
+
+    // run chunks until no queue has any left
+    void drain(int self)
+    {
+        int chunk;
+        while (take(self, chunk))
+        {
+            (*job)(chunk);
+            if (--left == 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    bool take(int self, int& chunk)
+    {
+        int n = queues.size();
+        for (int k = 0; k < n; k++)
+        {
+            Queue* q = queues[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if (q->chunks.empty()) continue;
+            if (!k)
+            {
+                chunk = q->chunks.front();
+                q->chunks.pop_front();
+            }
+            else
+            {
+                chunk = q->chunks.back();
+                q->chunks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace sjtu
+
+#endif
@@ -0,0 +1,93 @@
+// the routing records of released trains, compiled into a memory-mapped snapshot
+#ifndef TIMETABLE_HPP
+#define TIMETABLE_HPP
+
+#include "../file/Mapfile.hpp"
+
+namespace sjtu
+{
+
+// released trains never change, so their records are appended once and then read in place;
+// an entry per train number finds them and holds what still changes, the address of its seat matrix
+class Timetable
+{
+public:
+    Timetable(const std::string& name): records(name), index(name + "_index") {}
+
+    bool has(int train_no) const
+    {
+        return offset(train_no) != 0;
+    }
+
+    char* record(int train_no)
+    {
+        return records.at(offset(train_no));
+    }
+
+    // records may move, so views of them taken before this are no longer valid
+    void add(int train_no, const char* record, int len)
+    {
+        long at = records.append(record, len);
+        index.extend(slot(train_no + 1));
+        entry(train_no)->offset = at;
+    }
+
+    // its matrix in the seat file, 0 until a ticket is sold or if not released
+    long seats(int train_no) const
+    {
+        if (!indexed(train_no)) return 0;
+        return reinterpret_cast<const Entry*>(index.at(slot(train_no)))->seats;
+    }
+
+    // only a released train has somewhere to keep it
+    void set_seats(int train_no, long address)
+    {
+        if (!indexed(train_no)) return;
+        entry(train_no)->seats = address;
+    }
+
+    long bytes() const
+    {
+        return records.end();
+    }
+
+    void clean()
+    {
+        records.clean();
+        index.clean();
+    }
+
+private:
+    struct Entry
+    {
+        long offset; // in records, 0 if not released
+        long seats;
+    };
+    Mapfile records;
+    Mapfile index; // entries by train_no
+
+    static long slot(int train_no)
+    {
+        return sizeof(long) + (long)train_no * sizeof(Entry);
+    }
+
+    Entry* entry(int train_no)
+    {
+        return reinterpret_cast<Entry*>(index.at(slot(train_no)));
+    }
+
+    bool indexed(int train_no) const
+    {
+        return train_no >= 0 && slot(train_no + 1) <= index.end();
+    }
+
+    long offset(int train_no) const
+    {
+        if (!indexed(train_no)) return 0;
+        return reinterpret_cast<const Entry*>(index.at(slot(train_no)))->offset;
+    }
+};
+
+} // namespace sjtu
+
+#endif
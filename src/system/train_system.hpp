@@ -9,8 +9,18 @@
 #include "../STLite/vector.hpp"
 #include "../STLite/map.hpp"
 #include "../file/Mystring.hpp"
+#include "../file/Dictionary.hpp"
+#include "../file/Slotfile.hpp"
+#include "../file/Matrixfile.hpp"
+#include "../file/Logfile.hpp"
 #include "../B_plus_tree/Multi_BPT.hpp"
 #include "date.hpp"
+#include "seats.hpp"
+#include "pair_index.hpp"
+#include "result_cache.hpp"
+#include "thread_pool.hpp"
+#include "connection_scan.hpp"
+#include "timetable.hpp"
 
 #define MAXSTA 100
 
@@ -23,7 +33,7 @@ struct Train_Data
     Date end_date;
     Time leave_time[MAXSTA-1]; // no leave_time for last station
     Time arrive_time[MAXSTA-1]; // no arrive_time for first station
-    char stations[MAXSTA][31];
+    short stations[MAXSTA]; // ids in the station dictionary
     bool released;
     char station_num;
     char type;
@@ -31,252 +41,353 @@ struct Train_Data
     int price[MAXSTA]; // the price from first station
 };
 
+// a stored train is a head followed by price[n], stations[n], leave_time[n-1] and arrive_time[n-1],
+// so a record is only as long as the train; the view points into the record
+template<typename Head>
+struct Columns: Head
+{
+    const int* price;
+    const short* stations;
+    const Time* leave_time;
+    const Time* arrive_time;
+
+    Columns(const char* record)
+    {
+        static_cast<Head&>(*this) = *reinterpret_cast<const Head*>(record);
+        int n = this->station_num;
+        record += sizeof(Head);
+        price = reinterpret_cast<const int*>(record);
+        record += n * sizeof(int);
+        stations = reinterpret_cast<const short*>(record);
+        record += n * sizeof(short);
+        leave_time = reinterpret_cast<const Time*>(record);
+        record += (n - 1) * sizeof(Time);
+        arrive_time = reinterpret_cast<const Time*>(record);
+    }
+
+    constexpr static int size(int n)
+    {
+        return sizeof(Head) + n * (sizeof(int) + sizeof(short)) + 2 * (n - 1) * sizeof(Time);
+    }
+
+    // write head and columns into record and return its length
+    static int pack(const Head& head, const int* price, const short* stations,
+                    const Time* leave_time, const Time* arrive_time, char* record)
+    {
+        *reinterpret_cast<Head*>(record) = head;
+        int n = head.station_num;
+        char* p = record + sizeof(Head);
+        memcpy(p, price, n * sizeof(int));
+        p += n * sizeof(int);
+        memcpy(p, stations, n * sizeof(short));
+        p += n * sizeof(short);
+        memcpy(p, leave_time, (n - 1) * sizeof(Time));
+        p += (n - 1) * sizeof(Time);
+        memcpy(p, arrive_time, (n - 1) * sizeof(Time));
+        return size(n);
+    }
+};
+
+// the full record, read by query_train and order creation
+struct Train_Head
+{
+    Date start_date;
+    Date end_date;
+    int seat;
+    bool released;
+    char station_num;
+    char type;
+};
+using Train_View = Columns<Train_Head>;
+static_assert(Train_View::size(MAXSTA) <= Slotfile::capacity(), "a full train must fit in one page");
+
+// the routing view of a released train, all query_ticket and query_transfer look at
+struct Route_Head
+{
+    int seat;
+    Date start_date;
+    Date end_date;
+    char station_num;
+};
+using Route_View = Columns<Route_Head>;
+
 class Train_System
 {
 public:
-    Train_System(): train_db("train"), train_index("station_index"), seat_db("seat"),
-    order_db("order"), order_index("user_order_index"), order_queue("order_queue") {}
-    ~Train_System() = default;
+    Train_System(): station_dict("station"), train_dict("train_id"), train_heap("train_record"), train_db("train"),
+    timetable("timetable"), train_index("station_index"), pair_index("station_pair"),
+    seat_file("seat_matrix"), order_log("order_log"), order_lists("user_orders"), order_queue("order_queue") {}
+    ~Train_System()
+    {
+        drop_postings();
+        drop_waitlists();
+    }
+
+    short station_id(const Mystring<31>& name)
+    {
+        return station_dict.intern(name);
+    }
 
     bool is_id_exist(const Mystring<21>& id)
     {
-        auto found = train_db.readonly(id);
-        if (found != nullptr) return true;
-        return false;
+        int train_no = train_dict.find(id);
+        if (train_no == -1) return false;
+        return train_db.readonly(train_no) != nullptr;
     }
 
     void add_train(const Mystring<21>& id, const Train_Data& data)
     {
-        train_db.insert(id, data);
+        char record[Slotfile::capacity()];
+        Train_Head head;
+        head.start_date = data.start_date;
+        head.end_date = data.end_date;
+        head.seat = data.seat;
+        head.released = data.released;
+        head.station_num = data.station_num;
+        head.type = data.type;
+        int len = Train_View::pack(head, data.price, data.stations, data.leave_time, data.arrive_time, record);
+        train_db.insert(train_dict.intern(id), train_heap.insert(record, len));
         std::cout << "0\n";
     }
 
     int delete_train(const Mystring<21>& id)
     {
-        auto found = train_db.readonly(id);
-        if (found == nullptr || found->released) return -1;
-        train_db.erase(id);
+        int train_no = train_dict.find(id);
+        if (train_no == -1) return -1;
+        auto found = train_db.readonly(train_no);
+        if (found == nullptr) return -1;
+        long address = *found;
+        if (Train_View(train_heap.readonly(address)).released) return -1;
+        train_db.erase(train_no);
+        train_heap.erase(address);
         return 0;
     }
 
     int release_train(const Mystring<21>& id)
     {
-        auto found = train_db.readwrite(id);
-        if (found == nullptr || found->released) return -1;
-        found->released = true;
-        Index_Info info;
-        info.train_id = id;
-        for (char i = 0; i < found->station_num; i++)
-        {
-            info.num = i;
-            train_index.insert(found->stations[i], info);
-        }
-        Seat_Index index;
-        index.id = id;
-        index.date = found->start_date;
-        Seats seats;
-        for (int i = 0; i < found->station_num - 1; i++)
-            seats[i] = found->seat;
-        for (; index.date < found->end_date; ++index.date)
-            seat_db.insert(index, seats);
-        seat_db.insert(index, seats);
+        int train_no = train_dict.find(id);
+        if (train_no == -1) return -1;
+        auto address = train_db.readonly(train_no);
+        if (address == nullptr) return -1;
+        Train_Head* head = reinterpret_cast<Train_Head*>(train_heap.readwrite(*address));
+        if (head->released) return -1;
+        head->released = true;
+        Train_View train(train_heap.readonly(*address));
+        Route_Head route;
+        route.seat = train.seat;
+        route.start_date = train.start_date;
+        route.end_date = train.end_date;
+        route.station_num = train.station_num;
+        char record[Slotfile::capacity()];
+        int len = Route_View::pack(route, train.price, train.stations, train.leave_time, train.arrive_time, record);
+        timetable.add(train_no, record, len);
+        Route_View view = read_route(train_no);
+        for (char i = 0; i < train.station_num; i++)
+        {
+            Index_Info info = index_info(view, train_no, i);
+            train_index.insert(train.stations[i], info);
+            add_posting(train.stations[i], info);
+        }
+        index_pairs(train_no);
+        forget_journeys(read_route(train_no));
+        vector<int> days;
+        connections.compiled(days);
+        for (int i = 0; i < days.size(); i++)
+            compile_train(train_no, days[i]);
         return 0;
     }
 
     void query_train(const Mystring<21>& id, Date d)
     {
-        auto found = train_db.readonly(id);
-        if (found == nullptr)
+        int train_no = train_dict.find(id);
+        if (train_no == -1)
         {
             std::cout << "-1\n";
             return;
         }
-        if (d < found->start_date || found->end_date < d)
+        auto address = train_db.readonly(train_no);
+        if (address == nullptr)
         {
             std::cout << "-1\n";
             return;
         }
-        if (found->released)
+        Train_View train(train_heap.readonly(*address));
+        if (d < train.start_date || train.end_date < d)
         {
-            Seat_Index index;
-            index.date = d;
-            index.id = id;
-            auto seat = seat_db.readonly(index);
-            std::cout << id << ' ' << found->type << '\n';
-            std::cout << found->stations[0] << " xx-xx xx:xx -> " << d << ' ' << 
-            found->leave_time[0] << " 0 " << seat->s[0] << '\n';
+            std::cout << "-1\n";
+            return;
+        }
+        if (train.released)
+        {
+            std::cout << id << ' ' << train.type << '\n';
+            std::cout << station_dict.name(train.stations[0]) << " xx-xx xx:xx -> " << d << ' ' << 
+            train.leave_time[0] << " 0 " << seats_left(train_no, d, 0, 1) << '\n';
             Date day;
             Time t;
-            for (char i = 1; i < found->station_num - 1; i++)
+            for (char i = 1; i < train.station_num - 1; i++)
             {
                 day = d;
-                t = found->arrive_time[i-1];
+                t = train.arrive_time[i-1];
                 adjust_date(day, t);
-                std::cout << found->stations[i] << ' ' << day << ' ' << t << " -> ";
+                std::cout << station_dict.name(train.stations[i]) << ' ' << day << ' ' << t << " -> ";
                 day = d;
-                t = found->leave_time[i];
+                t = train.leave_time[i];
                 adjust_date(day, t);
-                std::cout << day << ' ' << t << ' ' << found->price[i] << ' ' << seat->s[i] << '\n';
+                std::cout << day << ' ' << t << ' ' << train.price[i] << ' ' << seats_left(train_no, d, i, i + 1) << '\n';
             }
             day = d;
-            t = found->arrive_time[found->station_num-2];
+            t = train.arrive_time[train.station_num-2];
             adjust_date(day, t);
-            std::cout << found->stations[found->station_num-1] << ' ' << day << ' ' << t <<
-            " -> xx-xx xx:xx " << found->price[found->station_num-1] << " x\n";
+            std::cout << station_dict.name(train.stations[train.station_num-1]) << ' ' << day << ' ' << t <<
+            " -> xx-xx xx:xx " << train.price[train.station_num-1] << " x\n";
         }
         else
         {
-            std::cout << id << ' ' << found->type << '\n';
-            std::cout << found->stations[0] << " xx-xx xx:xx -> " << d << ' ' << 
-            found->leave_time[0] << " 0 " << found->seat << '\n';
+            std::cout << id << ' ' << train.type << '\n';
+            std::cout << station_dict.name(train.stations[0]) << " xx-xx xx:xx -> " << d << ' ' << 
+            train.leave_time[0] << " 0 " << train.seat << '\n';
             Date day;
             Time t;
-            for (char i = 1; i < found->station_num - 1; i++)
+            for (char i = 1; i < train.station_num - 1; i++)
             {
                 day = d;
-                t = found->arrive_time[i-1];
+                t = train.arrive_time[i-1];
                 adjust_date(day, t);
-                std::cout << found->stations[i] << ' ' << day << ' ' << t << " -> ";
+                std::cout << station_dict.name(train.stations[i]) << ' ' << day << ' ' << t << " -> ";
                 day = d;
-                t = found->leave_time[i];
+                t = train.leave_time[i];
                 adjust_date(day, t);
-                std::cout << day << ' ' << t << ' ' << found->price[i] << ' ' << found->seat << '\n';
+                std::cout << day << ' ' << t << ' ' << train.price[i] << ' ' << train.seat << '\n';
             }
             day = d;
-            t = found->arrive_time[found->station_num-2];
+            t = train.arrive_time[train.station_num-2];
             adjust_date(day, t);
-            std::cout << found->stations[found->station_num-1] << ' ' << day << ' ' << t <<
-            " -> xx-xx xx:xx " << found->price[found->station_num-1] << " x\n";
+            std::cout << station_dict.name(train.stations[train.station_num-1]) << ' ' << day << ' ' << t <<
+            " -> xx-xx xx:xx " << train.price[train.station_num-1] << " x\n";
         } 
     }
 
     // p = 0 for "-p time", p = 1 for "-p cost"
     void query_ticket(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p) 
     {
-        vector<Index_Info> candidate;
-        vector<char> to_num;
-        find_train(a, b, candidate, to_num);
-        int size = candidate.size();
-        Journey_Data journey;
-        vector<Journey_Data> res;
-        for (int i = 0; i < size; ++i)
-        {
-            auto train = train_db.readonly(candidate[i].train_id);
-            // check validity
-            if (candidate[i].num == train->station_num) continue;
-            Time origin_leave_time = journey.leave_time = train->leave_time[candidate[i].num];
-            int offset = 0;
-            while (journey.leave_time.h >= 24)
-            {
-                ++offset;
-                journey.leave_time.h -= 24;
-            }
-            Date require_date = d;
-            require_date -= offset;
-            if (require_date < train->start_date || train->end_date < require_date) continue;
-            // fill in information
-            strcpy(journey.train_id, candidate[i].train_id.string);
-            journey.leave_date = d;
-            journey.arrive_date = require_date;
-            journey.arrive_time = train->arrive_time[to_num[i]-1];
-            journey.time = journey.arrive_time - origin_leave_time;
-            adjust_date(journey.arrive_date, journey.arrive_time);
-            journey.price = train->price[to_num[i]] - train->price[candidate[i].num];
-            journey.seat = 1e9;
-            Seat_Index index;
-            index.id = candidate[i].train_id;
-            index.date = require_date;
-            auto seat = seat_db.readonly(index);
-            for (char j = candidate[i].num; j < to_num[i]; j++)
-                journey.seat = std::min(journey.seat, seat->s[j]);
-            res.push_back(journey);
-        }
-        size = res.size();
-        int* array = new int[size];
-        for (int i = 0; i < size; i++)
-            array[i] = i;
-        if (!p) // -p time
+        Ticket_Cache::Key key;
+        key.from = station_dict.find(a);
+        key.to = station_dict.find(b);
+        key.d = d;
+        key.p = p;
+        const vector<Journey_Data>* res = ticket_cache.find(key);
+        vector<Journey_Data> fresh;
+        if (res == nullptr)
         {
-            sort(array, array+size, 
-            [&res](int x, int y)
-            {
-                return res[x].time < res[y].time;
-            });
-        }
-        else // -p cost
-        {
-            sort(array, array+size, 
-            [&res](int x, int y)
-            {
-                return res[x].price < res[y].price;
-            });
+            find_journeys(key.from, key.to, d, p, fresh);
+            if (key.from >= 0 && key.to >= 0) ticket_cache.insert(key, fresh);
+            res = &fresh;
         }
+        // seat counts are never cached, they are read from the seat rows each time
+        int size = res->size();
         std::cout << size << '\n';
         for (int i = 0; i < size; i++)
         {
-            int j = array[i];
-            std::cout << res[j].train_id << ' ' << a << ' ' << res[j].leave_date << ' ' << res[j].leave_time << " -> " <<
-            b << ' ' << res[j].arrive_date << ' ' << res[j].arrive_time << ' ' << res[j].price << ' ' << res[j].seat << '\n';
+            const Journey_Data& j = (*res)[i];
+            std::cout << j.train_id << ' ' << a << ' ' << j.leave_date << ' ' << j.leave_time << " -> " <<
+            b << ' ' << j.arrive_date << ' ' << j.arrive_time << ' ' << j.price << ' ' <<
+            seats_left(j.train_no, j.start_date, j.f_id, j.t_id) << '\n';
         }
-        delete []array;
     }
 
-    void query_transfer(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p)
+    // k == 0 prints the best transfer alone; otherwise the count of the k best comes first
+    void query_transfer(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p, int k = 0)
     {
-        Transfer_Info info;
-        info.cost = info.time = 1e9;
-        if (!find_transfer(a, b, d, p, info))
+        vector<Transfer_Info> res;
+        if (k >= 0)
+            find_transfer(station_dict.find(a), station_dict.find(b), d, p, k ? k : 1, res);
+        if (k)
+            std::cout << res.size() << '\n';
+        else if (res.empty())
         {
             std::cout << "0\n";
             return;
         }
-        // print a_train info
-        auto a_train = train_db.readonly(info.train_id[0]);
-        Time a_leave_time = a_train->leave_time[info.f_id[0]], a_arrive_time = a_train->arrive_time[info.t_id[0]-1];
-        int a_offset = a_leave_time.h / 24;
-        a_leave_time.h %= 24;
-        Seat_Index a_index;
-        a_index.id = info.train_id[0];
-        Date a_arrive_date = a_index.date = d - a_offset;
-        adjust_date(a_arrive_date, a_arrive_time);
-        auto a_seat = seat_db.readonly(a_index);
-        int left = 1e9;
-        for (int i = info.f_id[0]; i < info.t_id[0]; i++)
-            left = std::min(left, a_seat->s[i]);
-        std::cout << info.train_id[0] << ' ' << a << ' ' << d << ' ' << a_leave_time << " -> " << a_train->stations[info.t_id[0]] << ' ' << 
-        a_arrive_date << ' ' << a_arrive_time << ' ' << a_train->price[info.t_id[0]] - a_train->price[info.f_id[0]] << ' ' << left << '\n';
-        // print b_train info
-        auto b_train = train_db.readonly(info.train_id[1]);
-        Time b_leave_time = b_train->leave_time[info.f_id[1]], b_arrive_time = b_train->arrive_time[info.t_id[1]-1];
-        Seat_Index b_index;
-        b_index.id = info.train_id[1];
-        Date b_leave_date = b_index.date = info.date;
-        Date b_arrive_date = b_leave_date;
-        adjust_date(b_leave_date, b_leave_time);
-        adjust_date(b_arrive_date, b_arrive_time);
-        auto b_seat = seat_db.readonly(b_index);
-        left = 1e9;
-        for (int i = info.f_id[1]; i < info.t_id[1]; i++)
-            left = std::min(left, b_seat->s[i]);
-        std::cout << info.train_id[1] << ' ' << b_train->stations[info.f_id[1]] << ' ' << b_leave_date << ' ' << b_leave_time << " -> " << b << ' ' <<
-        b_arrive_date << ' ' << b_arrive_time << ' ' << b_train->price[info.t_id[1]] - b_train->price[info.f_id[1]] << ' ' << left << '\n';
+        for (int i = 0; i < res.size(); i++)
+            print_transfer(res[i], a, b, d);
+    }
+
+    // Pareto optimal journeys by (arrival, cost) with at most n transfers, earliest first; the search only
+    // uses trains leaving within Connection_Scan::DAYS days of d and does not look at seats, so a journey
+    // with a sold-out leg is left out rather than replaced by a worse one that still has seats
+    void query_route(const Mystring<31>& a, const Mystring<31>& b, Date d, int n)
+    {
+        short from = station_dict.find(a), to = station_dict.find(b);
+        vector<vector<Route_Leg>> res;
+        if (from >= 0 && to >= 0 && from != to && n >= 0)
+        {
+            connections.evict(d.n);
+            for (int day = d.n; day < d.n + Connection_Scan::DAYS; day++)
+                if (connections.find_day(day) == nullptr)
+                    compile_day(day);
+            vector<vector<Route_Leg>> found;
+            connections.search(from, to, d, n, station_dict.number(), found);
+            for (size_t i = 0; i < found.size(); i++)
+            {
+                bool open = true;
+                for (size_t j = 0; open && j < found[i].size(); j++)
+                {
+                    const Route_Leg& leg = found[i][j];
+                    open = seats_left(leg.train_no, leg.start, leg.f_id, leg.t_id) > 0;
+                }
+                if (open) res.push_back(found[i]);
+            }
+        }
+        std::cout << res.size() << '\n';
+        for (size_t i = 0; i < res.size(); i++)
+        {
+            const vector<Route_Leg>& journey = res[i];
+            int cost = 0;
+            for (size_t j = 0; j < journey.size(); j++)
+                cost += journey[j].cost;
+            std::cout << journey.size() << ' ' << journey[journey.size()-1].arr - journey[0].dep << ' ' << cost << '\n';
+            for (size_t j = 0; j < journey.size(); j++)
+            {
+                const Route_Leg& leg = journey[j];
+                Route_View train = read_route(leg.train_no);
+                Date leave_date, arrive_date;
+                Time leave_time, arrive_time;
+                leave_date.n = leg.dep / 1440;
+                leave_time.h = leg.dep % 1440 / 60;
+                leave_time.m = leg.dep % 60;
+                arrive_date.n = leg.arr / 1440;
+                arrive_time.h = leg.arr % 1440 / 60;
+                arrive_time.m = leg.arr % 60;
+                std::cout << train_dict.name(leg.train_no) << ' ' << station_dict.name(train.stations[leg.f_id]) << ' ' <<
+                leave_date << ' ' << leave_time << " -> " << station_dict.name(train.stations[leg.t_id]) << ' ' <<
+                arrive_date << ' ' << arrive_time << ' ' << leg.cost << ' ' << seats_left(leg.train_no, leg.start, leg.f_id, leg.t_id) << '\n';
+            }
+        }
     }
 
     void buy_ticket(const Mystring<21>& u, const Mystring<21>& id, Date d,
                     const Mystring<31>& from, const Mystring<31>& to, int n, bool q)
     {
-        auto train = train_db.readonly(id);
-        if (train == nullptr || !train->released)
+        int train_no = train_dict.find(id);
+        auto found = train_no == -1 ? nullptr : train_db.readonly(train_no);
+        if (found == nullptr)
+        {
+            std::cout << "-1\n";
+            return;
+        }
+        Train_View train(train_heap.readonly(*found));
+        if (!train.released)
         {
             std::cout << "-1\n";
             return;
         }
         int f_id = -1, t_id = -1;
-        for (int i = 0; i < train->station_num; i++)
+        short from_s = station_dict.find(from), to_s = station_dict.find(to);
+        for (int i = 0; i < train.station_num; i++)
         {
-            if (!strcmp(from.string, train->stations[i]))
+            if (train.stations[i] == from_s)
                 f_id = i;
-            else if (!strcmp(to.string, train->stations[i]))
+            else if (train.stations[i] == to_s)
             {
                 t_id = i;
                 break;
@@ -287,76 +398,76 @@ public:
             std::cout << "-1\n";
             return;
         }
-        Seat_Index index;
-        index.id = id;
-        int offset = train->leave_time[f_id].h / 24;
-        index.date = d - offset;
-        auto seat = seat_db.readonly(index);
-        if (seat == nullptr)
+        int offset = train.leave_time[f_id].h / 24;
+        Date date = d - offset;
+        if (date < train.start_date || train.end_date < date)
         {
             std::cout << "-1\n";
             return;
         }
-        int left = 1e9;
-        for (int i = f_id; i < t_id; i++)
-            left = std::min(left, seat->s[i]);
-        if ((left < n && !q) || n > train->seat)
+        long index = queue_key(train_no, date);
+        int left = seats_left(train_no, date, f_id, t_id);
+        if ((left < n && !q) || n > train.seat)
         {
             std::cout << "-1\n";
             return;
         }
         Order_Data order;
-        strcpy(order.train_id, id.string);
-        order.d = index.date;
-        strcpy(order.from, from.string);
-        strcpy(order.to, to.string);
+        order.train_no = train_no;
+        order.d = date;
+        order.from = from_s;
+        order.to = to_s;
         order.f_id = f_id;
         order.t_id = t_id;
-        order.from_t = train->leave_time[f_id];
-        order.to_t = train->arrive_time[t_id-1];
-        order.price = train->price[t_id] - train->price[f_id];
+        order.from_t = train.leave_time[f_id];
+        order.to_t = train.arrive_time[t_id-1];
+        order.price = train.price[t_id] - train.price[f_id];
         order.num = n;
         if (left >= n)
         {
             order.state = 1;
-            long address = order_db.new_space();
-            order_index.insert(u, -address);
-            order_db.write(address, order);
-            auto seat2 = seat_db.readwrite(index);
-            for (int i = f_id; i < t_id; i++)
-                seat2->s[i] -= n;
-            std::cout << (long long)n * (train->price[t_id] - train->price[f_id]) << '\n';
+            add_order(u, order);
+            auto seat2 = seat_row_write(train_no, date);
+            seat_add(seat2, f_id, t_id, -n);
+            std::cout << (long long)n * (train.price[t_id] - train.price[f_id]) << '\n';
             return;
         }
         order.state = 0;
-        long address = order_db.new_space();
-        order_index.insert(u, -address);
-        order_db.write(address, order);
-        order_queue.insert(index, address);
+        Wait_Info wait;
+        wait.seq = order_log.records();
+        wait.address = add_order(u, order);
+        wait.f_id = f_id;
+        wait.t_id = t_id;
+        wait.num = n;
+        order_queue.insert(index, wait);
+        // seq only grows, so a loaded waitlist stays in arrival order
+        auto loaded = waitlists.find(index);
+        if (loaded != waitlists.end()) loaded->second->push_back(wait);
         std::cout << "queue\n";
     }
 
     void query_order(const Mystring<21>& u)
     {
-        vector<long> res;
-        order_index.find(u, res);
+        vector<Order_Data> res;
+        auto list = order_lists.readonly(u);
+        if (list != nullptr) order_log.read(*list, res);
         std::cout << res.size() << '\n';
         for (auto i = res.begin(); i != res.end(); i++)
         {
-            auto order = order_db.readonly(-*i);
+            const Order_Data* order = &*i;
             if (order->state == 1)
                 std::cout << "[success] ";
             else if (!order->state)
                 std::cout << "[pending] ";
             else
                 std::cout << "[refunded] ";
-            std::cout << order->train_id << ' ';
-            std::cout << order->from << ' ';
+            std::cout << train_dict.name(order->train_no) << ' ';
+            std::cout << station_dict.name(order->from) << ' ';
             Date d = order->d;
             Time t = order->from_t;
             adjust_date(d, t);
             std::cout << d << ' ' << t << " -> ";
-            std::cout << order->to << ' ';
+            std::cout << station_dict.name(order->to) << ' ';
             d = order->d;
             t = order->to_t;
             adjust_date(d, t);
@@ -368,49 +479,87 @@ public:
 
     int refund_ticket(const Mystring<21>& u, int n)
     {
-        vector<long> order_v;
-        order_index.find(u, order_v);
-        if (n >= order_v.size()) return -1;
-        auto order = order_db.readwrite(-order_v[n]);
+        auto list = order_lists.readonly(u);
+        if (list == nullptr || n < 0 || n >= list->count) return -1;
+        long address = order_log.find(*list, n);
+        if (address == -1) return -1;
+        auto order = order_log.readwrite(address);
         if (order->state == -1) return -1;
-        Seat_Index index;
-        index.id = order->train_id;
-        index.date = order->d;
+        long index = queue_key(order->train_no, order->d);
+        vector<Wait_Info>& queue = waitlist(index);
         if (order->state == 0)
         {
+            size_t i = 0;
+            while (i < queue.size() && queue[i].address != address) i++;
+            if (i == queue.size()) return -1; // the queue on disk lost it
             order->state = -1;
-            order_queue.erase(index, -order_v[n]);
+            order_queue.erase(index, queue[i]);
+            for (; i + 1 < queue.size(); i++)
+                queue[i] = queue[i+1];
+            queue.pop_back();
+            if (queue.empty()) drop_waitlist(index);
             return 0;
         }
         order->state = -1;
-        auto seat = seat_db.readwrite(index);
-        for (int i = order->f_id; i < order->t_id; i++)
-            seat->s[i] += order->num;
-        vector<long> queue;
-        order_queue.find(index, queue);
-        for (auto it = queue.begin(); it != queue.end(); it++)
-        {
-            auto cptr = order_db.readonly(*it);
-            int left = 1e9;
-            for (int i = cptr->f_id; i < cptr->t_id; i++)
-                left = std::min(seat->s[i], left);
-            if (left < cptr->num) continue;
-            auto ptr = order_db.readwrite(*it);
-            ptr->state = 1;
-            for (int i = cptr->f_id; i < cptr->t_id; i++)
-                seat->s[i] -= cptr->num;
-            order_queue.erase(index, *it);
+        char f = order->f_id, t = order->t_id;
+        auto seat = seat_row_write(order->train_no, order->d);
+        seat_add(seat, f, t, order->num);
+        // no pending order could be served before, so only those sharing a segment with [f, t) can be now,
+        // and none that wants more than the most seats left on [f, t)
+        int most = seat_max(seat, f, t);
+        int kept = 0;
+        for (int i = 0; i < queue.size(); i++)
+        {
+            const Wait_Info& wait = queue[i];
+            if (wait.num > most || wait.t_id <= f || t <= wait.f_id || seat_min(seat, wait.f_id, wait.t_id) < wait.num)
+            {
+                queue[kept++] = wait;
+                continue;
+            }
+            order_log.readwrite(wait.address)->state = 1;
+            seat_add(seat, wait.f_id, wait.t_id, -wait.num);
+            order_queue.erase(index, wait);
+            most = seat_max(seat, f, t);
         }
+        while (queue.size() > kept) queue.pop_back();
+        if (queue.empty()) drop_waitlist(index);
         return 0;
     }
 
+    void tree_stats()
+    {
+        station_dict.stats("station");
+        train_dict.stats("train_id");
+        train_db.stats("train");
+        std::cout << "train_record: pages " << train_heap.pages() << '\n';
+        std::cout << "timetable: bytes " << timetable.bytes() << '\n';
+        train_index.stats("station_index");
+        if (pair_index.enabled()) pair_index.stats();
+        std::cout << "seat_matrix: pages " << seat_file.pages() << '\n';
+        order_lists.stats("user_orders");
+        std::cout << "order_log: pages " << order_log.pages() << '\n';
+        order_queue.stats("order_queue");
+    }
+
     void clean()
     {
+        station_dict.clean();
+        train_dict.clean();
+        train_heap.clean();
         train_db.clean();
+        timetable.clean();
         train_index.clean();
-        order_db.clean();
-        order_index.clean();
+        drop_postings();
+        pair_index.clean();
+        ticket_cache.clear();
+        connections.clear();
+        seat_file.clean();
+        order_log.clean();
+        order_lists.clean();
         order_queue.clean();
+        drop_waitlists();
+        names.clear();
+        named.clear();
     }
 
 private:
@@ -419,9 +568,9 @@ private:
         signed char state;// -1 for refunded, 0 for pending, 1 for success
         char f_id;
         char t_id;
-        char train_id[21];
-        char from[31];
-        char to[31];
+        int train_no;
+        short from; // station ids
+        short to;
         Time from_t;
         Time to_t;
         Date d; // departure date of the train, not the order
@@ -432,8 +581,11 @@ private:
     {
         int time;
         int price;
-        int seat;
-        char train_id[21];
+        int train_no;
+        char f_id;
+        char t_id;
+        Date start_date; // departure date of the train, for its seat row
+        Mystring<21> train_id;
         Date leave_date;
         Time leave_time;
         Date arrive_date;
@@ -441,218 +593,723 @@ private:
     };
     struct Index_Info
     {
+        int train_no;
+        Date first; // days the train leaves this station on
+        Date last;
+        short minute; // minute of the day it leaves
         char num;
-        Mystring<21> train_id;
+        char day; // days after leaving its first station; for the last station all refer to the arrival
         friend bool operator<(const Index_Info& a, const Index_Info& b)
         {
-            return a.train_id < b.train_id;
+            return a.train_no < b.train_no;
         }
         friend bool operator==(const Index_Info& a, const Index_Info& b)
         {
-            return a.train_id == b.train_id;
+            return a.train_no == b.train_no;
         }
     };
-    struct Seat_Index
+    struct Transfer_Info
+    {
+        int time;
+        int cost;
+        int train_no[2];
+        Date date; // departure date of train[1]
+        char f_id[2];
+        char t_id[2];
+        long rank; // position in the serial scan
+    };
+    Dictionary<31> station_dict;
+    Dictionary<21> train_dict;
+    Slotfile train_heap;
+    BPT<int, long> train_db; // train_no as index, long is address in train_heap
+    Timetable timetable; // route records of released trains
+    Multi_BPT<short, Index_Info> train_index; // station id as index
+    // trains through one station sorted by train_no, with the station's index on each
+    struct Posting
     {
-        Date date;
-        Mystring<21> id;
-        friend bool operator<(const Seat_Index& a, const Seat_Index& b)
+        vector<int> train_no; // kept apart from entry for galloping
+        vector<Index_Info> entry;
+        int size() const
         {
-            int res = strcmp(a.id.string, b.id.string);
-            if (res) return res < 0;
-            return a.date < b.date;
+            return train_no.size();
         }
-        friend bool operator==(const Seat_Index& a, const Seat_Index& b)
+    };
+    typedef Result_Cache<Journey_Data, 1024> Ticket_Cache;
+    constexpr static int PARALLEL_MIN = 512; // fewer candidates than this are evaluated serially
+    constexpr static int PARALLEL_GRAIN = 128;
+    constexpr static int PARALLEL_MIN_TRANSFER = 64; // second-leg trains below which query_transfer stays serial
+    constexpr static int PARALLEL_GRAIN_TRANSFER = 16;
+    Thread_Pool pool;
+    Ticket_Cache ticket_cache; // sorted query_ticket results, valid until a train through both stations is released
+    vector<Mystring<21>> names; // see train_name
+    vector<bool> named;
+    vector<Posting*> postings; // loaded posting lists of train_index, indexed by station id
+    Posting no_trains;
+    Pair_Index pair_index;
+    Connection_Scan connections; // compiled by day of departure on the first query_route that needs the day
+    // a first leg of a transfer, from a to an intermediate station
+    struct Leg
+    {
+        int train_no;
+        char f_id;
+        char t_id;
+        Date arrive_date;
+        Time arrive_time; // time of day
+        int time; // minutes spent on the first train
+        int cost;
+        int next; // next leg reaching the same station, -1 at the end
+    };
+    // find_transfer's join table: per station id the chain of legs reaching it, valid where leg_stamp is stamp
+    vector<Leg> legs;
+    vector<long> leg_stamp;
+    vector<int> leg_head;
+    vector<int> leg_tail;
+    long stamp = 0;
+    Matrixfile seat_file; // one dates x segments matrix per released train
+    typedef Logfile<Order_Data> Order_Log;
+    Order_Log order_log; // orders of each user, newest first
+    BPT<Mystring<21>, Order_Log::List> order_lists; // username as index
+    // a pending order, with what a refund needs to decide whether it can be served
+    struct Wait_Info
+    {
+        long seq; // orders ever logged before it
+        long address; // in order_log
+        char f_id;
+        char t_id;
+        int num;
+        friend bool operator<(const Wait_Info& a, const Wait_Info& b)
         {
-            return a.id == b.id && a.date == b.date;
+            return a.seq < b.seq;
+        }
+        friend bool operator==(const Wait_Info& a, const Wait_Info& b)
+        {
+            return a.seq == b.seq;
         }
     };
-    struct Seats
+    Multi_BPT<long, Wait_Info> order_queue; // queue_key as index, in order of arrival
+    map<long, vector<Wait_Info>*> waitlists; // loaded queues of order_queue
+
+    // routing view of a released train, read in place from the timetable;
+    // timetable.add may move the records, so a view must not be kept across a release
+    Route_View read_route(int train_no)
     {
-        int s[MAXSTA-1];
-        int& operator[](int i)
+        return Route_View(timetable.record(train_no));
+    }
+
+    // fewest seats left on segments [l, r) of a released train leaving its first station on day d;
+    // a train that never sold a ticket has no matrix and is full on every day
+    int seats_left(int train_no, Date d, int l, int r)
+    {
+        Route_View route = read_route(train_no);
+        long seats = timetable.seats(train_no);
+        if (!seats) return route.seat;
+        return seat_min(seat_file.readonly(seats, route.station_num - 1, d - route.start_date), l, r);
+    }
+
+    // the matrix is materialized on the first write
+    int* seat_row_write(int train_no, Date d)
+    {
+        Route_View route = read_route(train_no);
+        long seats = timetable.seats(train_no);
+        if (!seats)
         {
-            return s[i];
+            seats = seat_file.allocate(route.end_date - route.start_date + 1, route.station_num - 1, route.seat);
+            timetable.set_seats(train_no, seats);
         }
-    };
-    struct Transfer_Info
+        return seat_file.readwrite(seats, route.station_num - 1, d - route.start_date);
+    }
+
+    // waiting queues are keyed by (train_no, day) packed into one integer
+    static long queue_key(int train_no, Date d)
     {
-        int time;
-        int cost;
-        Mystring<21> train_id[2];
-        Date date; // departure date of train[1]
-        char f_id[2];
-        char t_id[2];
-    };
-    BPT<Mystring<21>, Train_Data> train_db;
-    Multi_BPT<Mystring<31>, Index_Info> train_index; // station name as index
-    BPT<Seat_Index, Seats> seat_db;
-    Datafile<Order_Data> order_db;
-    Multi_BPT<Mystring<21>, long> order_index; // long is -address in order_db, username as index
-    Multi_BPT<Seat_Index, long> order_queue; // long is address in order_db
-
-    // find all trains that go from a to b
-    void find_train(const Mystring<31>& a, const Mystring<31>& b, vector<Index_Info>& res, vector<char>& to_num)
-    {
-        vector<Index_Info> av, bv;
-        train_index.find(a, av);
-        if (av.empty()) return;
-        train_index.find(b, bv);
-        if (bv.empty()) return;
-        auto aptr = av.begin();
-        auto bptr = bv.begin();
-        int toreserve = std::min(av.size(), bv.size());
-        res.reserve(toreserve);
-        to_num.reserve(toreserve);
-        while (true)
+        return (long)train_no << 16 | (unsigned short)d.n;
+    }
+
+    // append order to the log of user u and return its address
+    long add_order(const Mystring<21>& u, const Order_Data& order)
+    {
+        Order_Log::List* list = order_lists.readwrite(u);
+        if (list != nullptr) return order_log.append(*list, order);
+        Order_Log::List fresh;
+        long res = order_log.append(fresh, order);
+        order_lists.insert(u, fresh);
+        return res;
+    }
+
+    // waiting queue of a key, read from order_queue once and then kept in memory
+    vector<Wait_Info>& waitlist(long key)
+    {
+        auto loaded = waitlists.find(key);
+        if (loaded != waitlists.end()) return *loaded->second;
+        vector<Wait_Info>* queue = new vector<Wait_Info>;
+        order_queue.find(key, *queue);
+        waitlists.insert(pair<const long, vector<Wait_Info>*>(key, queue));
+        return *queue;
+    }
+
+    // an empty queue is not worth keeping loaded
+    void drop_waitlist(long key)
+    {
+        auto loaded = waitlists.find(key);
+        delete loaded->second;
+        waitlists.erase(loaded);
+    }
+
+    void drop_waitlists()
+    {
+        for (auto it = waitlists.begin(); it != waitlists.end(); ++it)
+            delete it->second;
+        waitlists.clear();
+    }
+
+    // find all trains that go from a to b leaving a on d
+    void find_train(short a, short b, Date d, vector<Index_Info>& res, vector<char>& to_num)
+    {
+        if (pair_ready(a, b))
         {
-            while (aptr != av.end() && (*aptr).train_id < (*bptr).train_id) ++aptr;
-            if (aptr == av.end()) return;
-            if ((*aptr).train_id == (*bptr).train_id)
+            vector<Pair_Info> found;
+            pair_index.find(a, b, found);
+            for (int i = 0; i < found.size(); i++)
             {
-                if ((*aptr).num < (*bptr).num)
-                {
-                    res.push_back(*aptr);
-                    to_num.push_back((*bptr).num);
-                }
-                ++aptr;
+                Index_Info info = index_info(read_route(found[i].train_no), found[i].train_no, found[i].f);
+                if (d < info.first || info.last < d) continue;
+                res.push_back(info);
+                to_num.push_back(found[i].t);
+            }
+            return;
+        }
+        const Posting& pa = posting(a);
+        const Posting& pb = posting(b);
+        // walk the shorter list and gallop through the longer one
+        bool a_short = pa.size() <= pb.size();
+        const Posting& small = a_short ? pa : pb;
+        const Posting& large = a_short ? pb : pa;
+        for (int i = 0, j = 0; i < small.size(); i++)
+        {
+            j = gallop(large.train_no, j, small.train_no[i]);
+            if (j == large.size()) return;
+            if (large.train_no[j] != small.train_no[i]) continue;
+            const Index_Info& from = a_short ? small.entry[i] : large.entry[j];
+            char t = a_short ? large.entry[j].num : small.entry[i].num;
+            if (from.num >= t || d < from.first || from.last < d) continue;
+            res.push_back(from);
+            to_num.push_back(t);
+        }
+    }
+
+    // first position at or after lo holding a train_no >= x, probing lo, lo+1, lo+3, lo+7, ... before a binary search
+    static int gallop(const vector<int>& list, int lo, int x)
+    {
+        int n = list.size(), step = 1, hi = lo;
+        while (hi < n && list[hi] < x)
+        {
+            lo = hi + 1;
+            hi += step;
+            step <<= 1;
+        }
+        if (hi > n) hi = n;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (list[mid] < x) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // posting list of station s, read from train_index once and then kept in memory
+    const Posting& posting(short s)
+    {
+        if (s < 0) return no_trains;
+        while (postings.size() <= s) postings.push_back(nullptr);
+        if (postings[s] == nullptr)
+        {
+            vector<Index_Info> found;
+            train_index.find(s, found);
+            Posting* p = new Posting;
+            p->train_no.reserve(found.size());
+            p->entry.reserve(found.size());
+            for (int i = 0; i < found.size(); i++)
+            {
+                p->train_no.push_back(found[i].train_no);
+                p->entry.push_back(found[i]);
             }
-            ++bptr;
-            if (aptr == av.end() || bptr == bv.end()) return;
-            while (bptr != bv.end() && (*bptr).train_id < (*aptr).train_id) ++bptr;
-            if (bptr == bv.end()) return;
-            if ((*aptr).train_id == (*bptr).train_id)
+            postings[s] = p;
+        }
+        return *postings[s];
+    }
+
+    // journeys from a to b leaving on d, sorted as query_ticket prints them
+    void find_journeys(short a, short b, Date d, bool p, vector<Journey_Data>& sorted)
+    {
+        vector<Index_Info> candidate;
+        vector<char> to_num;
+        find_train(a, b, d, candidate, to_num);
+        int size = candidate.size();
+        vector<Journey_Data> res;
+        if (size < PARALLEL_MIN)
+        {
+            Journey_Data journey;
+            for (int i = 0; i < size; ++i)
+            {
+                evaluate(read_route(candidate[i].train_no), candidate[i], to_num[i], d, journey);
+                journey.train_id = train_dict.name(journey.train_no);
+                res.push_back(journey);
+            }
+        }
+        else
+        {
+            // workers read routes from the timetable and only write their own slots;
+            // merging in candidate order keeps the result identical to the serial loop
+            Journey_Data* all = new Journey_Data[size];
+            pool.parallel_for(size, PARALLEL_GRAIN, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++)
+                    evaluate(read_route(candidate[i].train_no), candidate[i], to_num[i], d, all[i]);
+            });
+            for (int i = 0; i < size; ++i)
+            {
+                all[i].train_id = train_dict.name(all[i].train_no);
+                res.push_back(all[i]);
+            }
+            delete []all;
+        }
+        size = res.size();
+        int* array = new int[size];
+        for (int i = 0; i < size; i++)
+            array[i] = i;
+        if (!p) // -p time
+        {
+            sort(array, array+size, 
+            [&res](int x, int y)
+            {
+                if (res[x].time != res[y].time) return res[x].time < res[y].time;
+                return res[x].train_id < res[y].train_id;
+            });
+        }
+        else // -p cost
+        {
+            sort(array, array+size, 
+            [&res](int x, int y)
             {
-                if ((*aptr).num < (*bptr).num)
+                if (res[x].price != res[y].price) return res[x].price < res[y].price;
+                return res[x].train_id < res[y].train_id;
+            });
+        }
+        sorted.reserve(size);
+        for (int i = 0; i < size; i++)
+            sorted.push_back(res[array[i]]);
+        delete []array;
+    }
+
+    // fill in journey for a candidate that leaves from.num on d, all but its train_id
+    static void evaluate(const Route_View& train, const Index_Info& from, char to, Date d, Journey_Data& journey)
+    {
+        journey.leave_time.h = from.minute / 60;
+        journey.leave_time.m = from.minute % 60;
+        journey.train_no = from.train_no;
+        journey.f_id = from.num;
+        journey.t_id = to;
+        journey.start_date = d - from.day;
+        journey.leave_date = d;
+        journey.arrive_date = journey.start_date;
+        journey.arrive_time = train.arrive_time[to-1];
+        journey.time = journey.arrive_time.h * 60 + journey.arrive_time.m - from.day * 1440 - from.minute;
+        adjust_date(journey.arrive_date, journey.arrive_time);
+        journey.price = train.price[to] - train.price[from.num];
+    }
+
+    // the train_index entry of station num on a train
+    static Index_Info index_info(const Route_View& train, int train_no, char num)
+    {
+        Index_Info res;
+        Time t = num + 1 < train.station_num ? train.leave_time[num] : train.arrive_time[num-1];
+        res.train_no = train_no;
+        res.num = num;
+        res.day = t.h / 24;
+        res.minute = t.h % 24 * 60 + t.m;
+        res.first = train.start_date + res.day;
+        res.last = train.end_date + res.day;
+        return res;
+    }
+
+    // a released train only changes the journeys between two of its stations, in its direction
+    void forget_journeys(const Route_View& train)
+    {
+        ticket_cache.erase_if([&train](const Ticket_Cache::Key& key)
+        {
+            int i = 0;
+            while (i < train.station_num && train.stations[i] != key.from) i++;
+            for (i++; i < train.station_num; i++)
+                if (train.stations[i] == key.to) return true;
+            return false;
+        });
+    }
+
+    // pair_index holds every train from a to b once both stations are hot
+    bool pair_ready(short a, short b)
+    {
+        if (a < 0 || b < 0 || !pair_index.usable()) return false;
+        int degree = pair_index.degree();
+        return (int)posting(a).size() >= degree && (int)posting(b).size() >= degree;
+    }
+
+    // whether station s was hot before train, just released, was added to its posting list
+    bool was_hot(short s, const Route_View& train)
+    {
+        int degree = posting(s).size();
+        for (int i = 0; i < train.station_num; i++)
+            if (train.stations[i] == s) --degree;
+        return degree >= pair_index.degree();
+    }
+
+    bool add_pair(const Route_View& train, int train_no, char f, char t)
+    {
+        Pair_Info info;
+        info.train_no = train_no;
+        info.f = std::min(f, t);
+        info.t = std::max(f, t);
+        return pair_index.insert(train.stations[info.f], train.stations[info.t], info);
+    }
+
+    // index the pairs of hot stations on a newly released train; a station it makes hot
+    // first gets its pairs with every hot station on all of its trains
+    void index_pairs(int train_no)
+    {
+        if (!pair_index.usable()) return;
+        Route_View train = read_route(train_no);
+        vector<short> fresh; // stations made hot by this train whose pairs are done
+        for (int i = 0; i < train.station_num; i++)
+        {
+            short s = train.stations[i];
+            const Posting& p = posting(s);
+            if ((int)p.size() != pair_index.degree()) continue;
+            for (int k = 0; k < p.size(); k++)
+            {
+                Route_View other = read_route(p.train_no[k]);
+                for (char j = 0; j < other.station_num; j++)
                 {
-                    res.push_back(*aptr);
-                    to_num.push_back((*bptr).num);
+                    short x = other.stations[j];
+                    if (j == p.entry[k].num) continue;
+                    bool hot = was_hot(x, train);
+                    for (int l = 0; !hot && l < fresh.size(); l++)
+                        hot = fresh[l] == x;
+                    if (hot && !add_pair(other, p.train_no[k], p.entry[k].num, j)) return;
                 }
-                ++bptr;
             }
-            ++aptr;
-            if (aptr == av.end() || bptr == bv.end()) return; 
+            fresh.push_back(s);
+        }
+        for (char i = 0; i < train.station_num; i++)
+        {
+            if (!was_hot(train.stations[i], train)) continue;
+            for (char j = i + 1; j < train.station_num; j++)
+                if (was_hot(train.stations[j], train) && !add_pair(train, train_no, i, j)) return;
+        }
+    }
+
+    // keep a loaded posting list in step with train_index
+    void add_posting(short s, const Index_Info& info)
+    {
+        if (s >= postings.size() || postings[s] == nullptr) return;
+        Posting* p = postings[s];
+        int pos = gallop(p->train_no, 0, info.train_no);
+        p->train_no.insert(pos, info.train_no);
+        p->entry.insert(pos, info);
+    }
+
+    void drop_postings()
+    {
+        for (int i = 0; i < postings.size(); i++)
+            delete postings[i];
+        postings.clear();
+    }
+
+    // train ids by train_no, read from train_dict once; ids never change before clean, so a loaded one stays valid
+    const Mystring<21>& train_name(int train_no)
+    {
+        while (names.size() <= train_no)
+        {
+            names.push_back(Mystring<21>());
+            named.push_back(false);
         }
+        if (!named[train_no])
+        {
+            names[train_no] = train_dict.name(train_no);
+            named[train_no] = true;
+        }
+        return names[train_no];
+    }
+
+    // ties are broken by train id strings, not by interning order
+    bool train_name_less(const Transfer_Info& a, const Transfer_Info& b)
+    {
+        if (a.train_no[0] != b.train_no[0])
+            return train_name(a.train_no[0]) < train_name(b.train_no[0]);
+        if (a.train_no[1] == b.train_no[1]) return false;
+        return train_name(a.train_no[1]) < train_name(b.train_no[1]);
     }
 
-    static bool transfer_comp_time(const Transfer_Info& a, const Transfer_Info& b)
+    bool transfer_comp_time(const Transfer_Info& a, const Transfer_Info& b)
     {
         if (a.time != b.time) return a.time < b.time;
         if (a.cost != b.cost) return a.cost < b.cost;
-        int res = strcmp(a.train_id[0].string, b.train_id[0].string);
-        if (res) return res < 0;
-        return a.train_id[1] < b.train_id[1];
+        return train_name_less(a, b);
     }
 
-    static bool transfer_comp_cost(const Transfer_Info& a, const Transfer_Info& b)
+    bool transfer_comp_cost(const Transfer_Info& a, const Transfer_Info& b)
     {
         if (a.cost != b.cost) return a.cost < b.cost;
         if (a.time != b.time) return a.time < b.time;
-        int res = strcmp(a.train_id[0].string, b.train_id[0].string);
-        if (res) return res < 0;
-        return a.train_id[1] < b.train_id[1];
-    }
-
-    // find the best transfer info
-    bool find_transfer(const Mystring<31>& a, const Mystring<31>& b, Date d, bool p, Transfer_Info& ret)
-    {
-        bool (*comp)(const Transfer_Info& a, const Transfer_Info& b);
-        if (!p) comp = transfer_comp_time;
-        else comp = transfer_comp_cost;
-        bool flag = false;
-        vector<Index_Info> a_index, b_index;
-        train_index.find(a, a_index);
-        // from_a: station as index, pair<id in a_index, t_id> as value
-        map<std::string, vector<pair<int, char>>> from_a;
-        // insert reachable city into from_a
+        return train_name_less(a, b);
+    }
+
+    // compile the connections of every released train leaving on day
+    void compile_day(int day)
+    {
+        connections.new_day(day);
+        for (int train_no = 0; train_no < train_dict.number(); train_no++)
+            if (timetable.has(train_no))
+                compile_train(train_no, day);
+    }
+
+    // add the segments of a released train that leave on a compiled day
+    void compile_train(int train_no, int day)
+    {
+        Route_View train = read_route(train_no);
+        int first = connections.trip(train_no, train.end_date - train.start_date + 1);
+        Connection c;
+        c.train_no = train_no;
+        for (char j = 0; j + 1 < train.station_num; j++)
+        {
+            int leave = train.leave_time[j].h * 60 + train.leave_time[j].m;
+            c.start.n = day - leave / 1440;
+            if (c.start < train.start_date || train.end_date < c.start)
+                continue;
+            c.dep = c.start.n * 1440 + leave;
+            c.arr = c.start.n * 1440 + train.arrive_time[j].h * 60 + train.arrive_time[j].m;
+            c.trip = first + (c.start - train.start_date);
+            c.price_f = train.price[j];
+            c.price_t = train.price[j+1];
+            c.from = train.stations[j];
+            c.to = train.stations[j+1];
+            c.seg = j;
+            connections.add(day, c);
+        }
+    }
+
+    // gather every first leg from a leaving on d into legs, chained per arrival station in a_index order
+    void collect_legs(short a, short b, Date d)
+    {
+        legs.clear();
+        ++stamp;
+        while (leg_stamp.size() < station_dict.number())
+        {
+            leg_stamp.push_back(0);
+            leg_head.push_back(-1);
+            leg_tail.push_back(-1);
+        }
+        const Posting& a_index = posting(a);
+        Leg leg;
+        leg.next = -1;
         for (int i = 0; i < a_index.size(); i++)
         {
-            // check date
-            auto train = train_db.readonly(a_index[i].train_id);
-            int offset = train->leave_time[a_index[i].num].h / 24;
-            Date require_d = d - offset;
-            if (require_d < train->start_date || train->end_date < require_d)
+            // check date before reading the train
+            const Index_Info& from = a_index.entry[i];
+            if (d < from.first || from.last < d)
                 continue;
-            // insert
-            for (char j = a_index[i].num + 1; j < train->station_num; j++)
+            Route_View train = read_route(a_index.train_no[i]);
+            char f_id = from.num;
+            int offset = from.day;
+            leg.train_no = a_index.train_no[i];
+            leg.f_id = f_id;
+            train_name(leg.train_no);
+            for (char j = f_id + 1; j < train.station_num; j++)
             {
-                if (train->stations[j] == b) continue;
-                pair<int, char> toinsert(i, j);
-                auto found = from_a.find(train->stations[j]);
-                if (found == from_a.end())
+                short s = train.stations[j];
+                if (s == b) continue;
+                leg.t_id = j;
+                leg.arrive_time = train.arrive_time[j-1];
+                leg.arrive_date = d;
+                leg.arrive_date += leg.arrive_time.h / 24 - offset;
+                leg.arrive_time.h %= 24;
+                leg.time = train.arrive_time[j-1] - train.leave_time[f_id];
+                leg.cost = train.price[j] - train.price[f_id];
+                int k = legs.size();
+                legs.push_back(leg);
+                if (leg_stamp[s] != stamp)
                 {
-                    vector<pair<int, char>> tmp_v;
-                    tmp_v.push_back(toinsert);
-                    from_a.insert(pair<std::string, vector<pair<int, char>>>(train->stations[j], tmp_v));
+                    leg_stamp[s] = stamp;
+                    leg_head[s] = k;
                 }
                 else
-                    found->second.push_back(toinsert);
+                    legs[leg_tail[s]].next = k;
+                leg_tail[s] = k;
             }
         }
-        if (from_a.empty()) return flag;
-        // iterate over trains passing by b
-        train_index.find(b, b_index);
+    }
+
+    // the two lines of a transfer from a to b leaving on d
+    void print_transfer(const Transfer_Info& info, const Mystring<31>& a, const Mystring<31>& b, Date d)
+    {
+        // print a_train info
+        Route_View a_train = read_route(info.train_no[0]);
+        Time a_leave_time = a_train.leave_time[info.f_id[0]], a_arrive_time = a_train.arrive_time[info.t_id[0]-1];
+        int a_offset = a_leave_time.h / 24;
+        a_leave_time.h %= 24;
+        Date a_arrive_date = d - a_offset;
+        int left = seats_left(info.train_no[0], a_arrive_date, info.f_id[0], info.t_id[0]);
+        adjust_date(a_arrive_date, a_arrive_time);
+        std::cout << train_dict.name(info.train_no[0]) << ' ' << a << ' ' << d << ' ' << a_leave_time << " -> " << station_dict.name(a_train.stations[info.t_id[0]]) << ' ' << 
+        a_arrive_date << ' ' << a_arrive_time << ' ' << a_train.price[info.t_id[0]] - a_train.price[info.f_id[0]] << ' ' << left << '\n';
+        // print b_train info
+        Route_View b_train = read_route(info.train_no[1]);
+        Time b_leave_time = b_train.leave_time[info.f_id[1]], b_arrive_time = b_train.arrive_time[info.t_id[1]-1];
+        Date b_leave_date = info.date;
+        Date b_arrive_date = b_leave_date;
+        adjust_date(b_leave_date, b_leave_time);
+        adjust_date(b_arrive_date, b_arrive_time);
+        left = seats_left(info.train_no[1], info.date, info.f_id[1], info.t_id[1]);
+        std::cout << train_dict.name(info.train_no[1]) << ' ' << station_dict.name(b_train.stations[info.f_id[1]]) << ' ' << b_leave_date << ' ' << b_leave_time << " -> " << b << ' ' <<
+        b_arrive_date << ' ' << b_arrive_time << ' ' << b_train.price[info.t_id[1]] - b_train.price[info.f_id[1]] << ' ' << left << '\n';
+    }
+
+    // order of two transfers under -p, ties going to the one scanned first
+    bool transfer_before(const Transfer_Info& a, const Transfer_Info& b, bool p)
+    {
+        if (!p ? transfer_comp_time(a, b) : transfer_comp_cost(a, b)) return true;
+        if (!p ? transfer_comp_time(b, a) : transfer_comp_cost(b, a)) return false;
+        return a.rank < b.rank;
+    }
+
+    // keep info if it is among the k best in top, a heap with the worst transfer at its root
+    void offer_transfer(vector<Transfer_Info>& top, int k, const Transfer_Info& info, bool p)
+    {
+        int i;
+        if (top.size() < k)
+        {
+            // sift up
+            top.push_back(info);
+            i = top.size() - 1;
+            while (i && transfer_before(top[(i-1)/2], info, p))
+            {
+                top[i] = top[(i-1)/2];
+                i = (i-1) / 2;
+            }
+            top[i] = info;
+            return;
+        }
+        if (!transfer_before(info, top[0], p)) return;
+        // replace the worst and sift down
+        int n = top.size();
+        i = 0;
+        while (true)
+        {
+            int c = 2 * i + 1;
+            if (c >= n) break;
+            if (c + 1 < n && transfer_before(top[c], top[c+1], p)) ++c;
+            if (!transfer_before(info, top[c], p)) break;
+            top[i] = top[c];
+            i = c;
+        }
+        top[i] = info;
+    }
+
+    // find the k best transfers, best first
+    void find_transfer(short a, short b, Date d, bool p, int k, vector<Transfer_Info>& res)
+    {
+        if (a < 0 || b < 0) return;
+        collect_legs(a, b, d);
+        if (legs.empty()) return;
+        // iterate over trains passing by b; workers only read, so train ids are loaded first
+        const Posting& b_index = posting(b);
+        int size = b_index.size();
+        for (int i = 0; i < size; i++)
+            train_name(b_index.train_no[i]);
+        vector<Transfer_Info> top;
+        if (size < PARALLEL_MIN_TRANSFER)
+            scan_transfers(b_index, 0, size, d, p, k, top);
+        else
+        {
+            int chunks = (size + PARALLEL_GRAIN_TRANSFER - 1) / PARALLEL_GRAIN_TRANSFER;
+            vector<Transfer_Info>* best = new vector<Transfer_Info>[chunks];
+            pool.parallel_for(size, PARALLEL_GRAIN_TRANSFER, [&](int begin, int end)
+            {
+                scan_transfers(b_index, begin, end, d, p, k, best[begin / PARALLEL_GRAIN_TRANSFER]);
+            });
+            // ranks tell the serial scan order apart, so merging gives the same transfers
+            for (int c = 0; c < chunks; c++)
+                for (int i = 0; i < best[c].size(); i++)
+                    offer_transfer(top, k, best[c][i], p);
+            delete []best;
+        }
+        size = top.size();
+        Transfer_Info* array = new Transfer_Info[size];
+        for (int i = 0; i < size; i++)
+            array[i] = top[i];
+        sort(array, array+size, 
+        [this, p](const Transfer_Info& x, const Transfer_Info& y)
+        {
+            return transfer_before(x, y, p);
+        });
+        res.reserve(size);
+        for (int i = 0; i < size; i++)
+            res.push_back(array[i]);
+        delete []array;
+    }
+
+    // offer top every transfer whose second train is b_index[begin, end)
+    void scan_transfers(const Posting& b_index, int begin, int end, Date d, bool p, int k, vector<Transfer_Info>& top)
+    {
         Transfer_Info tmp_info;
-        for (int i = 0; i < b_index.size(); i++)
+        for (int i = begin; i < end; i++)
         {
             // check date (roughly)
-            char b_id = b_index[i].num;
-            auto b_train = train_db.readonly(b_index[i].train_id);
-            char offset = b_train->arrive_time[b_id-1].h / 24;
-            Time b_arrive_t = b_train->arrive_time[b_id];
-            b_arrive_t.h -= 24 * offset;
+            char b_id = b_index.entry[i].num;
+            Route_View b_train = read_route(b_index.train_no[i]);
+            int offset = b_train.arrive_time[b_id-1].h / 24;
             Date require_d = d - offset;
-            if (b_train->end_date < require_d)
+            if (b_train.end_date < require_d)
                 continue;
             // iterate over stations earlier than b
-            tmp_info.train_id[1] = b_index[i].train_id;
+            tmp_info.train_no[1] = b_index.train_no[i];
             tmp_info.t_id[1] = b_id;
             for (int j = 0; j < b_id; j++)
             {
-                auto found = from_a.find(b_train->stations[j]);
-                if (found == from_a.end()) continue;
-                // iterate over possible train[0]
-                for (auto k = found->second.begin(); k != found->second.end(); k++)
+                short s = b_train.stations[j];
+                if (leg_stamp[s] != stamp) continue;
+                Time b_leave_t = b_train.leave_time[j];
+                offset = b_leave_t.h / 24;
+                b_leave_t.h %= 24;
+                int b_time = b_train.arrive_time[b_id-1] - b_train.leave_time[j];
+                int b_cost = b_train.price[b_id] - b_train.price[j];
+                // iterate over first legs reaching s
+                for (int l = leg_head[s]; l != -1; l = legs[l].next)
                 {
-                    auto a_id = a_index[(*k).first].train_id;
+                    const Leg& leg = legs[l];
                     // check duplicate
-                    if (a_id == b_index[i].train_id)
+                    if (leg.train_no == b_index.train_no[i])
+                        continue;
+                    // bounds that leave out the wait at s cannot beat the worst of k kept
+                    if (top.size() == k && (!p ? leg.time + b_time > top[0].time : leg.cost + b_cost > top[0].cost))
                         continue;
-                    char f_id = a_index[(*k).first].num;
-                    char t_id = (*k).second;
-                    auto a_train = train_db.readonly(a_id);
                     // find earliest required departure date of b_train
-                    Time a_t = a_train->leave_time[f_id], t_t = a_train->arrive_time[t_id-1];
-                    Date t_d = d;
-                    t_d += t_t.h / 24 - a_t.h / 24;
-                    t_t.h %= 24;
-                    Time b_leave_t = b_train->leave_time[j];
-                    offset = b_leave_t.h / 24;
-                    b_leave_t.h %= 24;
-                    require_d = t_d - offset + (int)(b_leave_t < t_t);
-                    if (b_train->end_date < require_d)
+                    require_d = leg.arrive_date - offset + (int)(b_leave_t < leg.arrive_time);
+                    if (b_train.end_date < require_d)
                         continue;
                     // fill in tmp_info
-                    flag = true;
-                    tmp_info.train_id[0] = a_id;
-                    tmp_info.date = std::max(b_train->start_date, require_d);
-                    tmp_info.time = (a_train->arrive_time[t_id-1] - a_train->leave_time[f_id]) +
-                        time_between(t_d, t_t, tmp_info.date + offset, b_leave_t) + 
-                        (b_train->arrive_time[b_id-1] - b_train->leave_time[j]);
-                    tmp_info.cost = (a_train->price[t_id] - a_train->price[f_id]) + 
-                        (b_train->price[b_id] - b_train->price[j]);
-                    // try update ret
-                    if (comp(tmp_info, ret))
-                    {
-                        tmp_info.f_id[0] = f_id;
-                        tmp_info.f_id[1] = j;
-                        tmp_info.t_id[0] = t_id;
-                        ret = tmp_info;
-                    }
+                    tmp_info.train_no[0] = leg.train_no;
+                    tmp_info.date = std::max(b_train.start_date, require_d);
+                    tmp_info.time = leg.time + time_between(leg.arrive_date, leg.arrive_time, tmp_info.date + offset, b_leave_t) +
+                        b_time;
+                    tmp_info.cost = leg.cost + b_cost;
+                    tmp_info.f_id[0] = leg.f_id;
+                    tmp_info.f_id[1] = j;
+                    tmp_info.t_id[0] = leg.t_id;
+                    tmp_info.rank = ((long)i * MAXSTA + j) * legs.size() + l;
+                    offer_transfer(top, k, tmp_info, p);
                 }
             }
         }
-        return flag; 
     }
 
 };
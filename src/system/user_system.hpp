@@ -106,6 +106,11 @@ public:
         return true;
     }
 
+    void tree_stats()
+    {
+        userdb.stats("user");
+    }
+
     void clean()
     {
         userdb.clean();
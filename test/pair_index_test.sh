@@ -0,0 +1,23 @@
+#!/bin/sh
+# pair_index_test.sh BIN INPUT: query_ticket answers the same with the pair index off and on
+BIN=$1
+INPUT=$2
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+mkdir "$DIR/off" "$DIR/on"
+(cd "$DIR/off" && PAIR_DEGREE=0 "$BIN" < "$INPUT" > out) || exit 1
+(cd "$DIR/on" && PAIR_DEGREE=2 "$BIN" < "$INPUT" > out) || exit 1
+if ! cmp -s "$DIR/off/out" "$DIR/on/out"; then
+    echo "query output differs with the pair index on"
+    diff "$DIR/off/out" "$DIR/on/out"
+    exit 1
+fi
+# the index must really have been used, and keeps its degree when reopened without the setting
+printf '[1] tree_stats\n[2] exit\n' > "$DIR/stats.in"
+(cd "$DIR/on" && "$BIN" < "$DIR/stats.in" > stats) || exit 1
+if ! grep -q "pair entries [1-9]" "$DIR/on/stats"; then
+    echo "the pair index stayed empty"
+    cat "$DIR/on/stats"
+    exit 1
+fi
+echo "same output with the pair index off and on"